@@ -0,0 +1,306 @@
+//
+// Copyright 2019 Sepehr Taghdisian (septag@github). All rights reserved.
+// License: https://github.com/septag/atlasc#license-bsd-2-clause
+//
+// atlasc-bench: builds atlases from a synthetic animation in memory and reports timings
+//      atlasc-bench --frames=500 --size=128 --scale=0.6 --runs=5
+//      --no-resize-cache allocates the resampling memory on every resize, to compare with reusing
+//      it. 0.5 and 0.25 use the box filter and integer upscales nearest, which don't use stbir
+//      --counters reports time and hardware counters (linux perf_event_open) of each stage, taken
+//      from atlasc's profiler zones. only the calling thread is counted, so stages that run on
+//      worker threads (colliders) report the time of waiting for them
+//
+#include "../include/atlasc.h"
+
+#include "sx/allocator.h"
+#include "sx/cmdline.h"
+#include "sx/string.h"
+#include "sx/threads.h"
+#include "sx/timer.h"
+
+#include <stdio.h>
+#include <stdlib.h>
+
+#if SX_PLATFORM_LINUX
+#    include <linux/perf_event.h>
+#    include <sys/syscall.h>
+#    include <unistd.h>
+#endif
+
+#define BENCH__NUM_COUNTERS 4
+
+typedef struct bench__stage {
+    const char* name;
+    uint64_t start_tm;
+    uint64_t start[BENCH__NUM_COUNTERS];
+    double ms;
+    uint64_t counts[BENCH__NUM_COUNTERS];
+} bench__stage;
+
+// per-sprite zones are not measured, reading the counters costs a syscall each
+static bench__stage g_stages[] = { { .name = "decode" }, { .name = "analysis" },
+                                   { .name = "colliders" }, { .name = "pack" },
+                                   { .name = "blit" }, { .name = "encode" },
+                                   { .name = "descriptor" } };
+static const char* g_counter_names[BENCH__NUM_COUNTERS] = { "cycles", "instructions",
+                                                            "llc-misses", "branch-misses" };
+static int g_counter_fds[BENCH__NUM_COUNTERS] = { -1, -1, -1, -1 };
+static uint32_t g_main_tid;
+
+// counters of the calling thread in user space, the ones the cpu (or vm) doesn't have stay -1
+static bool bench__open_counters(void)
+{
+    bool opened = false;
+#if SX_PLATFORM_LINUX
+    const uint64_t configs[BENCH__NUM_COUNTERS] = { PERF_COUNT_HW_CPU_CYCLES,
+                                                    PERF_COUNT_HW_INSTRUCTIONS,
+                                                    PERF_COUNT_HW_CACHE_MISSES,
+                                                    PERF_COUNT_HW_BRANCH_MISSES };
+    for (int i = 0; i < BENCH__NUM_COUNTERS; i++) {
+        struct perf_event_attr attr;
+        sx_memset(&attr, 0x0, sizeof(attr));
+        attr.size = sizeof(attr);
+        attr.type = PERF_TYPE_HARDWARE;
+        attr.config = configs[i];
+        attr.exclude_kernel = 1;
+        attr.exclude_hv = 1;
+        g_counter_fds[i] = (int)syscall(SYS_perf_event_open, &attr, 0, -1, -1, 0);
+        opened |= g_counter_fds[i] != -1;
+    }
+#endif
+    return opened;
+}
+
+static void bench__close_counters(void)
+{
+#if SX_PLATFORM_LINUX
+    for (int i = 0; i < BENCH__NUM_COUNTERS; i++) {
+        if (g_counter_fds[i] != -1)
+            close(g_counter_fds[i]);
+    }
+#endif
+}
+
+static void bench__read_counters(uint64_t values[BENCH__NUM_COUNTERS])
+{
+    for (int i = 0; i < BENCH__NUM_COUNTERS; i++) {
+        values[i] = 0;
+#if SX_PLATFORM_LINUX
+        if (g_counter_fds[i] != -1 && read(g_counter_fds[i], &values[i], sizeof(uint64_t)) < 0)
+            values[i] = 0;
+#endif
+    }
+}
+
+static bench__stage* bench__find_stage(const char* name, uint32_t thread_id)
+{
+    if (thread_id != g_main_tid)
+        return NULL;
+    for (int i = 0; i < (int)(sizeof(g_stages) / sizeof(g_stages[0])); i++) {
+        if (sx_strequal(g_stages[i].name, name))
+            return &g_stages[i];
+    }
+    return NULL;
+}
+
+static void bench__zone_begin(const char* name, uint32_t thread_id, void* ctx)
+{
+    sx_unused(ctx);
+    bench__stage* stage = bench__find_stage(name, thread_id);
+    if (stage) {
+        bench__read_counters(stage->start);
+        stage->start_tm = sx_tm_now();
+    }
+}
+
+static void bench__zone_end(const char* name, uint32_t thread_id,
+                            const atlasc_zone_counters* counters, void* ctx)
+{
+    sx_unused(counters);
+    sx_unused(ctx);
+    bench__stage* stage = bench__find_stage(name, thread_id);
+    if (stage) {
+        stage->ms += sx_tm_ms(sx_tm_since(stage->start_tm));
+        uint64_t values[BENCH__NUM_COUNTERS];
+        bench__read_counters(values);
+        for (int i = 0; i < BENCH__NUM_COUNTERS; i++)
+            stage->counts[i] += values[i] - stage->start[i];
+    }
+}
+
+static void bench__print_stages(int num_runs, bool has_counters)
+{
+    printf("%-12s %10s", "stage", "ms");
+    for (int i = 0; i < BENCH__NUM_COUNTERS && has_counters; i++)
+        printf(" %14s", g_counter_names[i]);
+    puts(has_counters ? "    ipc" : "");
+
+    for (int i = 0; i < (int)(sizeof(g_stages) / sizeof(g_stages[0])); i++) {
+        const bench__stage* stage = &g_stages[i];
+        if (stage->ms == 0)
+            continue;
+        printf("%-12s %10.2f", stage->name, stage->ms / num_runs);
+        for (int k = 0; k < BENCH__NUM_COUNTERS && has_counters; k++) {
+            if (g_counter_fds[k] != -1)
+                printf(" %14llu", (unsigned long long)(stage->counts[k] / num_runs));
+            else
+                printf(" %14s", "-");
+        }
+        if (has_counters && stage->counts[0] && g_counter_fds[0] != -1 && g_counter_fds[1] != -1)
+            printf(" %6.2f", (double)stage->counts[1] / (double)stage->counts[0]);
+        puts("");
+    }
+}
+
+// a blob that walks and squashes over the frames, with a gradient and transparent background
+static void bench__make_frame(uint8_t* pixels, int size, int frame, int num_frames)
+{
+    float t = (float)frame / (float)num_frames;
+    float cx = (float)size * (0.35f + 0.3f * t);
+    float cy = (float)size * 0.5f;
+    float rx = (float)size * (0.2f + 0.05f * sx_sin(t * SX_PI2 * 4.0f));
+    float ry = (float)size * 0.25f;
+    for (int y = 0; y < size; y++) {
+        for (int x = 0; x < size; x++) {
+            float dx = ((float)x - cx) / rx;
+            float dy = ((float)y - cy) / ry;
+            uint8_t* p = pixels + (y * size + x) * 4;
+            if (dx * dx + dy * dy <= 1.0f) {
+                p[0] = (uint8_t)(x * 255 / size);
+                p[1] = (uint8_t)(y * 255 / size);
+                p[2] = (uint8_t)(frame * 255 / num_frames);
+                p[3] = 255;
+            } else {
+                p[0] = p[1] = p[2] = p[3] = 0;
+            }
+        }
+    }
+}
+
+int main(int argc, char* argv[])
+{
+    const sx_alloc* alloc = sx_alloc_malloc();
+    int num_frames = 500;
+    int size = 128;
+    int num_runs = 5;
+    int mesh = 0;
+    int counters = 0;
+    int no_resize_cache = 0;
+    float scale = 0.6f;
+
+    const sx_cmdline_opt cmd_opts[] = {
+        { "help", 'h', SX_CMDLINE_OPTYPE_NO_ARG, 0x0, 'h', "Print help text", 0x0 },
+        { "frames", 'n', SX_CMDLINE_OPTYPE_REQUIRED, 0x0, 'n', "Animation frames (default:500)",
+          "Count" },
+        { "size", 'S', SX_CMDLINE_OPTYPE_REQUIRED, 0x0, 'S', "Frame size (default:128)",
+          "Pixels" },
+        { "scale", 's', SX_CMDLINE_OPTYPE_REQUIRED, 0x0, 's', "Scale (default:0.6)", "Number" },
+        { "runs", 'r', SX_CMDLINE_OPTYPE_REQUIRED, 0x0, 'r', "Builds to run (default:5)",
+          "Count" },
+        { "mesh", 'm', SX_CMDLINE_OPTYPE_FLAG_SET, &mesh, 1, "Make sprite meshes", NULL },
+        { "no-resize-cache", 'R', SX_CMDLINE_OPTYPE_FLAG_SET, &no_resize_cache, 1,
+          "Don't reuse resampling memory between resizes", NULL },
+        { "counters", 'c', SX_CMDLINE_OPTYPE_FLAG_SET, &counters, 1,
+          "Report time and hardware counters of each stage (linux)", NULL },
+        SX_CMDLINE_OPT_END
+    };
+    sx_cmdline_context* cmd = sx_cmdline_create_context(alloc, argc, (const char**)argv, cmd_opts);
+
+    int opt;
+    const char* arg;
+    char help[2048];
+
+    // clang-format off
+    while ((opt = sx_cmdline_next(cmd, NULL, &arg)) != -1) {
+        switch (opt) {
+        case 'h': puts(sx_cmdline_create_help_string(cmd, help, sizeof(help))); return 0;
+        case 'n': num_frames = sx_toint(arg); break;
+        case 'S': size = sx_toint(arg); break;
+        case 's': scale = sx_tofloat(arg); break;
+        case 'r': num_runs = sx_toint(arg); break;
+        default:  break;
+        }
+    }
+    // clang-format on
+    sx_cmdline_destroy_context(cmd, alloc);
+
+    if (num_frames <= 0 || size <= 1 || num_runs <= 0 || scale < 0.0001f) {
+        puts("invalid arguments");
+        return -1;
+    }
+
+    atlasc_image_data* images = malloc(sizeof(atlasc_image_data) * num_frames);
+    uint8_t* frames = malloc((size_t)size * size * 4 * num_frames);
+    if (!images || !frames) {
+        puts("out of memory");
+        return -1;
+    }
+    for (int i = 0; i < num_frames; i++)
+        bench__make_frame(frames + (size_t)size * size * 4 * i, size, i, num_frames);
+
+    atlasc_args_frommem args = { .common = { .alpha_threshold = 20,
+                                             .max_width = 4096,
+                                             .max_height = 4096,
+                                             .border = 2,
+                                             .padding = 1,
+                                             .mesh = mesh,
+                                             .max_verts_per_mesh = 25,
+                                             .scale = scale,
+                                             .no_resize_cache = no_resize_cache },
+                                 .images = images,
+                                 .num_images = num_frames };
+
+    sx_tm_init();
+    bool has_counters = false;
+    if (counters) {
+        g_main_tid = sx_thread_tid();
+        has_counters = bench__open_counters();
+        if (!has_counters) {
+#if SX_PLATFORM_LINUX
+            puts("hardware counters are not available (see /proc/sys/kernel/perf_event_paranoid)");
+#else
+            puts("hardware counters are only supported on linux");
+#endif
+        }
+        atlasc_set_profile_callbacks(bench__zone_begin, bench__zone_end, NULL);
+    }
+
+    double total_ms = 0, min_ms = 0;
+    for (int r = 0; r < num_runs; r++) {
+        // atlasc takes the ownership of input pixels
+        for (int i = 0; i < num_frames; i++) {
+            uint8_t* pixels = malloc((size_t)size * size * 4);
+            if (!pixels) {
+                puts("out of memory");
+                return -1;
+            }
+            sx_memcpy(pixels, frames + (size_t)size * size * 4 * i, size * size * 4);
+            images[i] = (atlasc_image_data){ .pixels = pixels, .width = size, .height = size };
+        }
+
+        uint64_t start = sx_tm_now();
+        atlasc_atlas_data* atlas = atlasc_make_inmem_frommem(&args);
+        double ms = sx_tm_ms(sx_tm_since(start));
+        if (!atlas) {
+            printf("build failed: %s\n", atlasc_error_string());
+            return -1;
+        }
+        atlasc_free(atlas);
+
+        total_ms += ms;
+        min_ms = r == 0 ? ms : sx_min(min_ms, ms);
+    }
+
+    printf("%d frames of %dx%d, scale %.3f, %d runs%s\n", num_frames, size, size, scale, num_runs,
+           no_resize_cache ? ", no resize cache" : "");
+    printf("build: %.2f ms (min), %.2f ms (avg), %.0f frames/s\n", min_ms, total_ms / num_runs,
+           (double)num_frames * 1000.0 / min_ms);
+    if (counters) {
+        bench__print_stages(num_runs, has_counters);
+        bench__close_counters();
+    }
+
+    free(frames);
+    free(images);
+    return 0;
+}
@@ -0,0 +1,656 @@
+//
+// Copyright 2019 Sepehr Taghdisian (septag@github). All rights reserved.
+// License: https://github.com/septag/atlasc#license-bsd-2-clause
+//
+// atlasc-reader.h - runtime reader for atlasc descriptors
+//      This is a single-header library with no dependencies, define ATLASC_READER_IMPLEMENTATION
+//      in one of your C/C++ files before including it. define ATLASC_READER_STATIC to make the
+//      functions static
+//
+// Layout (little-endian, offsets are relative to the start of the buffer):
+//      atlasc_bin_header
+//      atlasc_bin_sprite[num_sprites]
+//      atlasc_bin_sequence[num_sequences]
+//      string table (null-terminated strings, referenced by offset)
+//      mesh blob, for each sprite with a mesh (starts at atlasc_bin_sprite.mesh):
+//          int16_t positions[num_points*2]     relative to sprite_rect.xmin/ymin
+//          uint8_t indices[]                   zigzag delta coded indices, stored as LEB128 varints
+//      atlasc_bin_palette[num_palettes]
+//      uint32_t palette colors[num_palette_colors]     RGBA8, R in the lowest byte
+//      hit mask blob, for each sprite with ATLASC_BIN_FLAG_HIT_MASK (atlasc --hit-mask), starts at
+//      atlasc_bin_sprite.hit_mask: 1bit thresholded alpha of sprite_rect in cells of
+//      hit_mask_cell pixels, a bit is set if any pixel of the cell is opaque. rows of
+//      ceil(width / hit_mask_cell) bits start on byte boundaries, LSB first
+//      collider blob, for each sprite with convex pieces (atlasc --colliders), starts at
+//      atlasc_bin_sprite.colliders:
+//          uint8_t sizes[num_colliders]            vertices of each piece
+//          int16_t positions[num_collider_pts*2]   relative to sprite_rect.xmin/ymin, pieces one
+//                                                  after another, counter-clockwise with y up
+//      UVs are not stored, they are derived from positions:
+//          uv = position - sprite_rect.min + sheet_rect.min + padding
+//      Texture arrays (atlasc --array) have num_layers > 1, sheet_rect is within page `layer`
+//      Nine-slice sprites have non-zero `slice` insets, relative to src_size
+//      Duplicate sprites (atlasc --dedupe) share sheet_rect, `transform` tells how a sprite is
+//      made from it. to map a point of the sprite (relative to sprite_rect.min) into sheet_rect:
+//          FLIP_X: x = width - x, FLIP_Y: y = height - y, then ROTATE: (x, y) = (y, width - x)
+//      atlasc_bin_decode_mesh applies it to the UVs
+//      Recolored sprites (atlasc --palettes) share sheet_rect, which holds palette indices in the
+//      red channel (alpha is 255), and each of them has its own palette
+//      Sprite names are stored as sequences. Sprites are ordered by sequence and numbered frames
+//      of an animation (walk_0001.png, walk_0002.png, ...) are merged into a single sequence:
+//          name = dir/prefix + zero-padded (start + frame) + ext
+//          sprite index = first_sprite + frame
+//
+// API:
+//      atlasc_bin_load             validates the buffer and returns the header, NULL if invalid.
+//                                  the data is not copied, the buffer must stay valid
+//      atlasc_bin_sprites          returns sprite records
+//      atlasc_bin_sequences        returns sequence records
+//      atlasc_bin_string           returns a string from the string table
+//      atlasc_bin_sprite_name      builds the full name (filepath) of a sprite
+//      atlasc_bin_decode_mesh      decodes mesh data of a sprite into user provided buffers
+//      atlasc_bin_palettes         returns palette records
+//      atlasc_bin_palette_colors   returns the colors of a palette
+//      atlasc_bin_hit_test         tests a point of a sprite against its hit mask
+//      atlasc_bin_hit_mask         returns the hit mask bits of a sprite and their row pitch
+//      atlasc_bin_decode_colliders decodes convex pieces of a sprite into user provided buffers
+//
+// Compressed descriptors (atlasc --compress), applies to both json and binary descriptors:
+//      atlasc_lz_header followed by a single LZ4 block (https://github.com/lz4/lz4), check with
+//      `atlasc_lz_size` and decompress the data before passing it to `atlasc_bin_load` or a json
+//      parser
+//      atlasc_lz_size              returns decompressed size if data is compressed, 0 if not
+//      atlasc_lz_decompress        decompresses the data into user provided buffer
+//
+// Patches (atlasc --patch-from), updates the outputs of a previous build to the current one.
+// patch files are always compressed, decompress them with `atlasc_lz_decompress` first:
+//      atlasc_patch_header
+//      uint16_t tiles[num_tiles*2]         x, y of changed tiles (in tiles)
+//      uint8_t pixels[pixels_size]         RGBA pixels of changed tiles, clipped to image bounds
+//      uint8_t desc_ops[desc_ops_size]     descriptor delta, LEB128 varint coded operations:
+//                                          (len << 1) | 1, offset: copy len bytes from offset of
+//                                                                  the previous descriptor
+//                                          (len << 1), bytes:      insert len bytes
+//      atlasc_patch_load           validates the buffer and returns the header, NULL if invalid
+//      atlasc_patch_apply_image    applies changed tiles on the previous atlas image (RGBA)
+//      atlasc_patch_apply_desc     rebuilds the new descriptor from the previous one. descriptors
+//                                  are uncompressed data, same as what `atlasc_lz_decompress`
+//                                  returns
+//
+#pragma once
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+
+#ifndef ATLASC_READER_API
+#    ifdef ATLASC_READER_STATIC
+#        define ATLASC_READER_API static
+#    else
+#        define ATLASC_READER_API
+#    endif
+#endif
+
+#define ATLASC_BIN_MAGIC 0x424c5441    // 'ATLB'
+#define ATLASC_BIN_VERSION 8
+#define ATLASC_BIN_NO_PALETTE 0xffff
+#define ATLASC_LZ_MAGIC 0x5a4c5441    // 'ATLZ'
+#define ATLASC_PATCH_MAGIC 0x504c5441    // 'ATLP'
+#define ATLASC_PATCH_VERSION 1
+
+// same as atlasc.h, see atlasc_bin_sprite.transform
+#define ATLASC_TRANSFORM_FLIP_X 0x1
+#define ATLASC_TRANSFORM_FLIP_Y 0x2
+#define ATLASC_TRANSFORM_ROTATE 0x4
+
+typedef enum atlasc_bin_flags {
+    ATLASC_BIN_FLAG_MESH = 0x1,
+    ATLASC_BIN_FLAG_SLICE = 0x2,       // some sprites have nine-slice insets
+    ATLASC_BIN_FLAG_HIT_MASK = 0x4,    // sprites have hit masks
+    ATLASC_BIN_FLAG_COLLIDERS = 0x8    // some sprites have convex pieces
+} atlasc_bin_flags;
+
+typedef struct atlasc_bin_header {
+    uint32_t magic;
+    uint32_t version;
+    uint32_t flags;    // see atlasc_bin_flags
+    uint16_t image_width;
+    uint16_t image_height;
+    uint16_t padding;
+    uint16_t num_layers;    // texture array layers (pages), all of image_width x image_height
+    uint32_t num_sprites;
+    uint32_t num_sequences;
+    uint32_t image_name;    // offset into string table
+    uint32_t strings_offset;
+    uint32_t strings_size;
+    uint32_t sprites_offset;
+    uint32_t sequences_offset;
+    uint32_t meshes_offset;
+    uint32_t meshes_size;
+    uint32_t num_palettes;
+    uint32_t num_palette_colors;
+    uint32_t palettes_offset;
+    uint32_t hit_mask_cell;    // cell size of hit masks in pixels, 1 = pixel accurate
+    uint32_t hit_masks_offset;
+    uint32_t hit_masks_size;
+    uint32_t colliders_offset;
+    uint32_t colliders_size;
+} atlasc_bin_header;
+
+typedef struct atlasc_bin_sprite {
+    uint32_t sequence;          // index of the sequence that this sprite (frame) belongs to
+    uint16_t src_size[2];       // width, height
+    uint16_t sprite_rect[4];    // xmin, ymin, xmax, ymax
+    uint16_t sheet_rect[4];     // xmin, ymin, xmax, ymax
+    uint32_t mesh;              // offset into mesh blob (relative to meshes_offset)
+    uint16_t num_points;
+    uint16_t num_tris;
+    uint16_t layer;       // texture array layer of sheet_rect
+    uint16_t slice[4];    // nine-slice insets: left, top, right, bottom (0 = none)
+    uint16_t transform;   // ATLASC_TRANSFORM_* flags, sprite is a mirrored/rotated sheet_rect
+    uint16_t palette;     // ATLASC_BIN_NO_PALETTE for RGBA sprites
+    uint16_t reserved;
+    uint32_t hit_mask;     // offset into hit mask blob (relative to hit_masks_offset)
+    uint32_t colliders;    // offset into collider blob (relative to colliders_offset)
+    uint16_t num_colliders;
+    uint16_t num_collider_pts;
+} atlasc_bin_sprite;
+
+typedef struct atlasc_bin_sequence {
+    uint32_t dir;       // offset into string table, empty if there is no directory
+    uint32_t prefix;    // offset into string table
+    uint32_t ext;       // offset into string table
+    uint32_t start;     // frame number of the first sprite
+    uint32_t count;     // number of sprites (frames)
+    uint32_t digits;    // minimum digits of frame numbers (zero padded), 0 if it's not numbered
+    uint32_t first_sprite;
+} atlasc_bin_sequence;
+
+typedef struct atlasc_bin_palette {
+    uint32_t first_color;    // index into palette colors
+    uint32_t num_colors;
+} atlasc_bin_palette;
+
+typedef struct atlasc_lz_header {
+    uint32_t magic;
+    uint32_t size;               // decompressed size
+    uint32_t compressed_size;    // size of the LZ4 block that comes after the header
+} atlasc_lz_header;
+
+typedef struct atlasc_patch_header {
+    uint32_t magic;
+    uint32_t version;
+    uint16_t image_width;    // new image size
+    uint16_t image_height;
+    uint16_t prev_width;     // previous image size
+    uint16_t prev_height;
+    uint16_t tile_size;
+    uint16_t reserved;
+    uint32_t num_tiles;
+    uint32_t tiles_offset;
+    uint32_t pixels_offset;
+    uint32_t pixels_size;
+    uint32_t desc_size;    // size of the new descriptor
+    uint32_t desc_ops_offset;
+    uint32_t desc_ops_size;
+} atlasc_patch_header;
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+ATLASC_READER_API const atlasc_bin_header* atlasc_bin_load(const void* data, uint32_t size);
+ATLASC_READER_API const atlasc_bin_sprite* atlasc_bin_sprites(const atlasc_bin_header* hdr);
+ATLASC_READER_API const atlasc_bin_sequence* atlasc_bin_sequences(const atlasc_bin_header* hdr);
+ATLASC_READER_API const char* atlasc_bin_string(const atlasc_bin_header* hdr, uint32_t offset);
+// returns `buff`, name is truncated to `size`
+ATLASC_READER_API char* atlasc_bin_sprite_name(const atlasc_bin_header* hdr, uint32_t index,
+                                               char* buff, int size);
+
+ATLASC_READER_API const atlasc_bin_palette* atlasc_bin_palettes(const atlasc_bin_header* hdr);
+ATLASC_READER_API const uint32_t* atlasc_bin_palette_colors(const atlasc_bin_header* hdr,
+                                                            const atlasc_bin_palette* palette);
+
+// x, y are relative to the source image, same as positions of the mesh. returns false outside
+// sprite_rect or if there is no hit mask
+ATLASC_READER_API bool atlasc_bin_hit_test(const atlasc_bin_header* hdr,
+                                           const atlasc_bin_sprite* spr, int x, int y);
+// returns NULL if there is no hit mask, pitch receives the bytes of each row
+ATLASC_READER_API const uint8_t* atlasc_bin_hit_mask(const atlasc_bin_header* hdr,
+                                                     const atlasc_bin_sprite* spr, int* pitch);
+
+// positions and uvs receive num_points*2 ints, indices receives num_tris*3 indices
+// uvs and indices can be NULL. returns false if mesh data is corrupt
+ATLASC_READER_API bool atlasc_bin_decode_mesh(const atlasc_bin_header* hdr,
+                                              const atlasc_bin_sprite* spr, int* positions,
+                                              int* uvs, uint16_t* indices);
+
+// positions receive num_collider_pts*2 ints (relative to the source image, like mesh positions),
+// sizes receive num_colliders vertex counts. returns false if collider data is corrupt
+ATLASC_READER_API bool atlasc_bin_decode_colliders(const atlasc_bin_header* hdr,
+                                                   const atlasc_bin_sprite* spr, int* positions,
+                                                   int* sizes);
+
+ATLASC_READER_API uint32_t atlasc_lz_size(const void* data, uint32_t size);
+// dst_size must be the size returned by `atlasc_lz_size`. returns false if data is corrupt
+ATLASC_READER_API bool atlasc_lz_decompress(const void* data, uint32_t size, void* dst,
+                                            uint32_t dst_size);
+
+ATLASC_READER_API const atlasc_patch_header* atlasc_patch_load(const void* data, uint32_t size);
+// prev_pixels: previous image (prev_width*prev_height*4 bytes)
+// pixels: receives the new image (image_width*image_height*4 bytes), it can be the same buffer as
+//         prev_pixels if the image size is not changed
+ATLASC_READER_API bool atlasc_patch_apply_image(const atlasc_patch_header* patch,
+                                                const uint8_t* prev_pixels, uint8_t* pixels);
+// desc: receives the new descriptor (desc_size bytes). returns false if the data is corrupt
+ATLASC_READER_API bool atlasc_patch_apply_desc(const atlasc_patch_header* patch,
+                                               const void* prev_desc, uint32_t prev_size,
+                                               void* desc);
+
+#ifdef __cplusplus
+}
+#endif
+
+#ifdef ATLASC_READER_IMPLEMENTATION
+#include <stdio.h>
+#include <string.h>
+
+ATLASC_READER_API const atlasc_bin_header* atlasc_bin_load(const void* data, uint32_t size)
+{
+    const atlasc_bin_header* hdr = (const atlasc_bin_header*)data;
+    if (size < sizeof(atlasc_bin_header) || hdr->magic != ATLASC_BIN_MAGIC ||
+        hdr->version != ATLASC_BIN_VERSION) {
+        return NULL;
+    }
+
+    uint64_t sprites_end =
+        (uint64_t)hdr->sprites_offset + (uint64_t)hdr->num_sprites * sizeof(atlasc_bin_sprite);
+    uint64_t sequences_end = (uint64_t)hdr->sequences_offset +
+                             (uint64_t)hdr->num_sequences * sizeof(atlasc_bin_sequence);
+    if (sprites_end > size || sequences_end > size ||
+        (uint64_t)hdr->strings_offset + hdr->strings_size > size ||
+        (uint64_t)hdr->meshes_offset + hdr->meshes_size > size ||
+        (uint64_t)hdr->colliders_offset + hdr->colliders_size > size || hdr->strings_size == 0 ||
+        ((const char*)data)[hdr->strings_offset + hdr->strings_size - 1] != '\0') {
+        return NULL;
+    }
+
+    uint64_t palettes_end = (uint64_t)hdr->palettes_offset +
+                            (uint64_t)hdr->num_palettes * sizeof(atlasc_bin_palette) +
+                            (uint64_t)hdr->num_palette_colors * sizeof(uint32_t);
+    if (palettes_end > size)
+        return NULL;
+    const atlasc_bin_palette* palettes = atlasc_bin_palettes(hdr);
+    for (uint32_t i = 0; i < hdr->num_palettes; i++) {
+        if ((uint64_t)palettes[i].first_color + palettes[i].num_colors > hdr->num_palette_colors)
+            return NULL;
+    }
+
+    if (hdr->flags & ATLASC_BIN_FLAG_HIT_MASK) {
+        if (hdr->hit_mask_cell == 0 || hdr->hit_mask_cell > UINT16_MAX ||
+            (uint64_t)hdr->hit_masks_offset + hdr->hit_masks_size > size) {
+            return NULL;
+        }
+        const atlasc_bin_sprite* sprites = atlasc_bin_sprites(hdr);
+        for (uint32_t i = 0; i < hdr->num_sprites; i++) {
+            int pitch;
+            atlasc_bin_hit_mask(hdr, &sprites[i], &pitch);
+            int rows = ((int)sprites[i].sprite_rect[3] - (int)sprites[i].sprite_rect[1] +
+                        (int)hdr->hit_mask_cell - 1) / (int)hdr->hit_mask_cell;
+            if (rows < 0 || (uint64_t)sprites[i].hit_mask + (uint64_t)pitch * rows >
+                                hdr->hit_masks_size) {
+                return NULL;
+            }
+        }
+    }
+
+    return hdr;
+}
+
+ATLASC_READER_API const atlasc_bin_sprite* atlasc_bin_sprites(const atlasc_bin_header* hdr)
+{
+    return (const atlasc_bin_sprite*)((const uint8_t*)hdr + hdr->sprites_offset);
+}
+
+ATLASC_READER_API const atlasc_bin_sequence* atlasc_bin_sequences(const atlasc_bin_header* hdr)
+{
+    return (const atlasc_bin_sequence*)((const uint8_t*)hdr + hdr->sequences_offset);
+}
+
+ATLASC_READER_API const atlasc_bin_palette* atlasc_bin_palettes(const atlasc_bin_header* hdr)
+{
+    return (const atlasc_bin_palette*)((const uint8_t*)hdr + hdr->palettes_offset);
+}
+
+ATLASC_READER_API const uint32_t* atlasc_bin_palette_colors(const atlasc_bin_header* hdr,
+                                                            const atlasc_bin_palette* palette)
+{
+    const uint32_t* colors = (const uint32_t*)(atlasc_bin_palettes(hdr) + hdr->num_palettes);
+    return colors + palette->first_color;
+}
+
+ATLASC_READER_API const char* atlasc_bin_string(const atlasc_bin_header* hdr, uint32_t offset)
+{
+    return offset < hdr->strings_size ? (const char*)hdr + hdr->strings_offset + offset : "";
+}
+
+ATLASC_READER_API char* atlasc_bin_sprite_name(const atlasc_bin_header* hdr, uint32_t index,
+                                               char* buff, int size)
+{
+    buff[0] = '\0';
+    const atlasc_bin_sprite* spr = atlasc_bin_sprites(hdr) + index;
+    if (index >= hdr->num_sprites || spr->sequence >= hdr->num_sequences)
+        return buff;
+
+    const atlasc_bin_sequence* seq = atlasc_bin_sequences(hdr) + spr->sequence;
+    const char* dir = atlasc_bin_string(hdr, seq->dir);
+    const char* prefix = atlasc_bin_string(hdr, seq->prefix);
+    const char* ext = atlasc_bin_string(hdr, seq->ext);
+    if (seq->digits) {
+        snprintf(buff, size, "%s%s%s%0*u%s", dir, dir[0] ? "/" : "", prefix, (int)seq->digits,
+                 seq->start + (index - seq->first_sprite), ext);
+    } else {
+        snprintf(buff, size, "%s%s%s%s", dir, dir[0] ? "/" : "", prefix, ext);
+    }
+    return buff;
+}
+
+ATLASC_READER_API const uint8_t* atlasc_bin_hit_mask(const atlasc_bin_header* hdr,
+                                                     const atlasc_bin_sprite* spr, int* pitch)
+{
+    int w = (int)spr->sprite_rect[2] - (int)spr->sprite_rect[0];
+    *pitch = w > 0 && hdr->hit_mask_cell
+                 ? ((w + (int)hdr->hit_mask_cell - 1) / (int)hdr->hit_mask_cell + 7) >> 3
+                 : 0;
+    if (!(hdr->flags & ATLASC_BIN_FLAG_HIT_MASK))
+        return NULL;
+    return (const uint8_t*)hdr + hdr->hit_masks_offset + spr->hit_mask;
+}
+
+ATLASC_READER_API bool atlasc_bin_hit_test(const atlasc_bin_header* hdr,
+                                           const atlasc_bin_sprite* spr, int x, int y)
+{
+    x -= (int)spr->sprite_rect[0];
+    y -= (int)spr->sprite_rect[1];
+    if (x < 0 || y < 0 || x >= (int)spr->sprite_rect[2] - (int)spr->sprite_rect[0] ||
+        y >= (int)spr->sprite_rect[3] - (int)spr->sprite_rect[1]) {
+        return false;
+    }
+
+    int pitch;
+    const uint8_t* mask = atlasc_bin_hit_mask(hdr, spr, &pitch);
+    if (!mask)
+        return false;
+    x /= (int)hdr->hit_mask_cell;
+    y /= (int)hdr->hit_mask_cell;
+    return (mask[y * pitch + (x >> 3)] >> (x & 7)) & 1;
+}
+
+ATLASC_READER_API bool atlasc_bin_decode_mesh(const atlasc_bin_header* hdr,
+                                              const atlasc_bin_sprite* spr, int* positions,
+                                              int* uvs, uint16_t* indices)
+{
+    if (!spr->num_points)
+        return true;
+
+    // offsets are checked before they make pointers, corrupt ones could point anywhere
+    if ((uint64_t)spr->mesh + spr->num_points * 4 > hdr->meshes_size)
+        return false;
+    const uint8_t* blob = (const uint8_t*)hdr + hdr->meshes_offset;
+    const uint8_t* end = blob + hdr->meshes_size;
+    const uint8_t* p = blob + spr->mesh;
+
+    int uv_x = (int)spr->sheet_rect[0] + hdr->padding;
+    int uv_y = (int)spr->sheet_rect[1] + hdr->padding;
+    int w = (int)spr->sprite_rect[2] - (int)spr->sprite_rect[0];
+    int h = (int)spr->sprite_rect[3] - (int)spr->sprite_rect[1];
+    for (int i = 0; i < spr->num_points; i++, p += 4) {
+        int x = (int16_t)(p[0] | (p[1] << 8));
+        int y = (int16_t)(p[2] | (p[3] << 8));
+        positions[i * 2] = (int)spr->sprite_rect[0] + x;
+        positions[i * 2 + 1] = (int)spr->sprite_rect[1] + y;
+        if (uvs) {
+            if (spr->transform & ATLASC_TRANSFORM_FLIP_X)
+                x = w - x;
+            if (spr->transform & ATLASC_TRANSFORM_FLIP_Y)
+                y = h - y;
+            if (spr->transform & ATLASC_TRANSFORM_ROTATE) {
+                int t = x;
+                x = y;
+                y = w - t;
+            }
+            uvs[i * 2] = x + uv_x;
+            uvs[i * 2 + 1] = y + uv_y;
+        }
+    }
+
+    if (indices) {
+        int prev = 0;
+        for (int i = 0, c = (int)spr->num_tris * 3; i < c; i++) {
+            uint32_t v = 0;
+            int shift = 0;
+            do {
+                if (p == end || shift > 28)
+                    return false;
+                v |= (uint32_t)(*p & 0x7f) << shift;
+                shift += 7;
+            } while (*p++ & 0x80);
+
+            prev += (int)(v >> 1) ^ -(int)(v & 1);
+            if (prev < 0 || prev >= spr->num_points)
+                return false;
+            indices[i] = (uint16_t)prev;
+        }
+    }
+
+    return true;
+}
+
+ATLASC_READER_API bool atlasc_bin_decode_colliders(const atlasc_bin_header* hdr,
+                                                   const atlasc_bin_sprite* spr, int* positions,
+                                                   int* sizes)
+{
+    if (!spr->num_colliders)
+        return true;
+
+    if ((uint64_t)spr->colliders + spr->num_colliders + spr->num_collider_pts * 4 >
+        hdr->colliders_size) {
+        return false;
+    }
+    const uint8_t* p = (const uint8_t*)hdr + hdr->colliders_offset + spr->colliders;
+
+    int total = 0;
+    for (int i = 0; i < spr->num_colliders; i++) {
+        sizes[i] = p[i];
+        total += p[i];
+    }
+    if (total != spr->num_collider_pts)
+        return false;
+
+    p += spr->num_colliders;
+    for (int i = 0; i < spr->num_collider_pts; i++, p += 4) {
+        positions[i * 2] = (int)spr->sprite_rect[0] + (int16_t)(p[0] | (p[1] << 8));
+        positions[i * 2 + 1] = (int)spr->sprite_rect[1] + (int16_t)(p[2] | (p[3] << 8));
+    }
+    return true;
+}
+
+ATLASC_READER_API uint32_t atlasc_lz_size(const void* data, uint32_t size)
+{
+    const atlasc_lz_header* hdr = (const atlasc_lz_header*)data;
+    if (size < sizeof(atlasc_lz_header) || hdr->magic != ATLASC_LZ_MAGIC ||
+        hdr->compressed_size > size - sizeof(atlasc_lz_header)) {
+        return 0;
+    }
+    return hdr->size;
+}
+
+ATLASC_READER_API bool atlasc_lz_decompress(const void* data, uint32_t size, void* dst,
+                                            uint32_t dst_size)
+{
+    const atlasc_lz_header* hdr = (const atlasc_lz_header*)data;
+    if (atlasc_lz_size(data, size) != dst_size)
+        return false;
+
+    const uint8_t* ip = (const uint8_t*)data + sizeof(atlasc_lz_header);
+    const uint8_t* iend = ip + hdr->compressed_size;
+    uint8_t* op = (uint8_t*)dst;
+    uint8_t* oend = op + dst_size;
+
+    while (ip < iend) {
+        uint32_t token = *ip++;
+
+        // literals
+        uint32_t len = token >> 4;
+        if (len == 15) {
+            uint8_t b;
+            do {
+                if (ip == iend)
+                    return false;
+                b = *ip++;
+                len += b;
+            } while (b == 255);
+        }
+        if (len > (uint32_t)(iend - ip) || len > (uint32_t)(oend - op))
+            return false;
+        memcpy(op, ip, len);
+        ip += len;
+        op += len;
+        if (ip == iend)
+            break;    // last sequence only has literals
+
+        // match
+        if (iend - ip < 2)
+            return false;
+        uint32_t offset = (uint32_t)ip[0] | ((uint32_t)ip[1] << 8);
+        ip += 2;
+        if (offset == 0 || offset > (uint32_t)(op - (uint8_t*)dst))
+            return false;
+
+        len = token & 0xf;
+        if (len == 15) {
+            uint8_t b;
+            do {
+                if (ip == iend)
+                    return false;
+                b = *ip++;
+                len += b;
+            } while (b == 255);
+        }
+        len += 4;
+        if (len > (uint32_t)(oend - op))
+            return false;
+
+        const uint8_t* match = op - offset;
+        if (offset >= len) {
+            memcpy(op, match, len);
+            op += len;
+        } else {
+            // overlapping copy, repeats the pattern
+            for (uint32_t i = 0; i < len; i++)
+                *op++ = *match++;
+        }
+    }
+
+    return op == oend;
+}
+
+ATLASC_READER_API const atlasc_patch_header* atlasc_patch_load(const void* data, uint32_t size)
+{
+    const atlasc_patch_header* patch = (const atlasc_patch_header*)data;
+    if (size < sizeof(atlasc_patch_header) || patch->magic != ATLASC_PATCH_MAGIC ||
+        patch->version != ATLASC_PATCH_VERSION || patch->tile_size == 0) {
+        return NULL;
+    }
+
+    if ((uint64_t)patch->tiles_offset + (uint64_t)patch->num_tiles * 4 > size ||
+        (uint64_t)patch->pixels_offset + patch->pixels_size > size ||
+        (uint64_t)patch->desc_ops_offset + patch->desc_ops_size > size) {
+        return NULL;
+    }
+
+    return patch;
+}
+
+ATLASC_READER_API bool atlasc_patch_apply_image(const atlasc_patch_header* patch,
+                                                const uint8_t* prev_pixels, uint8_t* pixels)
+{
+    const int w = patch->image_width, h = patch->image_height;
+    const int pw = patch->prev_width, ph = patch->prev_height;
+    if (pixels != prev_pixels) {
+        for (int y = 0; y < h; y++) {
+            uint8_t* row = pixels + (size_t)y * w * 4;
+            int copy_w = y < ph ? (w < pw ? w : pw) : 0;
+            if (copy_w)
+                memcpy(row, prev_pixels + (size_t)y * pw * 4, (size_t)copy_w * 4);
+            memset(row + copy_w * 4, 0x0, (size_t)(w - copy_w) * 4);
+        }
+    } else if (w != pw || h != ph) {
+        return false;
+    }
+
+    const uint8_t* base = (const uint8_t*)patch;
+    const uint8_t* tiles = base + patch->tiles_offset;
+    const uint8_t* src = base + patch->pixels_offset;
+    const uint8_t* src_end = src + patch->pixels_size;
+    const int ts = patch->tile_size;
+    for (uint32_t i = 0; i < patch->num_tiles; i++, tiles += 4) {
+        int x0 = (tiles[0] | (tiles[1] << 8)) * ts;
+        int y0 = (tiles[2] | (tiles[3] << 8)) * ts;
+        if (x0 >= w || y0 >= h)
+            return false;
+        int tw = (w - x0) < ts ? (w - x0) : ts;
+        int th = (h - y0) < ts ? (h - y0) : ts;
+        if (src + (size_t)tw * th * 4 > src_end)
+            return false;
+        for (int y = 0; y < th; y++, src += tw * 4)
+            memcpy(pixels + ((size_t)(y0 + y) * w + x0) * 4, src, (size_t)tw * 4);
+    }
+
+    return true;
+}
+
+ATLASC_READER_API bool atlasc_patch_apply_desc(const atlasc_patch_header* patch,
+                                               const void* prev_desc, uint32_t prev_size,
+                                               void* desc)
+{
+    const uint8_t* p = (const uint8_t*)patch + patch->desc_ops_offset;
+    const uint8_t* end = p + patch->desc_ops_size;
+    uint8_t* op = (uint8_t*)desc;
+    uint8_t* oend = op + patch->desc_size;
+
+    while (p < end) {
+        uint32_t v[2] = { 0, 0 };
+        for (int k = 0; k < 2; k++) {
+            int shift = 0;
+            do {
+                if (p == end || shift > 28)
+                    return false;
+                v[k] |= (uint32_t)(*p & 0x7f) << shift;
+                shift += 7;
+            } while (*p++ & 0x80);
+
+            if (!(v[0] & 1))    // insert op has no offset
+                break;
+        }
+
+        uint32_t len = v[0] >> 1;
+        if (len > (uint32_t)(oend - op))
+            return false;
+        if (v[0] & 1) {
+            if ((uint64_t)v[1] + len > prev_size)
+                return false;
+            memcpy(op, (const uint8_t*)prev_desc + v[1], len);
+        } else {
+            if (len > (uint32_t)(end - p))
+                return false;
+            memcpy(op, p, len);
+            p += len;
+        }
+        op += len;
+    }
+
+    return op == oend;
+}
+
+#endif    // ATLASC_READER_IMPLEMENTATION
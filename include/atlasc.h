@@ -10,6 +10,20 @@
 
 #include "sx/math.h"
 
+// output pixel formats (atlasc_args.format). 16bit texels are little-endian, with the first
+// channel in the high bits: RGB565 = DXGI B5G6R5, RGBA4444 = B4G4R4A4, RGBA5551 = B5G5R5A1
+#define ATLASC_FORMAT_RGBA8 0
+#define ATLASC_FORMAT_RGB565 1
+#define ATLASC_FORMAT_RGBA4444 2
+#define ATLASC_FORMAT_RGBA5551 3
+#define ATLASC_FORMAT_COUNT 4
+
+// dithering of 16bit formats (atlasc_args.dither), each sprite is dithered on its own
+#define ATLASC_DITHER_NONE 0
+#define ATLASC_DITHER_ORDERED 1     // 4x4 bayer
+#define ATLASC_DITHER_DIFFUSE 2     // floyd-steinberg
+#define ATLASC_DITHER_COUNT 3
+
 typedef struct atlasc_args {
     int         alpha_threshold;
     float       dist_threshold;
@@ -21,12 +35,56 @@ typedef struct atlasc_args {
     int         mesh;
     int         max_verts_per_mesh;
     float       scale;
+    int         compact;    // write compact json schema (v2): flat arrays, struct-of-arrays sprites
+    int         binary;     // write binary descriptor instead of json (see atlasc-reader.h)
+    int         quantize_mesh;    // keep mesh positions as `qpts` instead of `pts` and `uvs`
+    int         compress;         // wrap the descriptor file in LZ4 container (see atlasc-reader.h)
+    int         optimize;         // search for the smallest png encoding on all cores (slow)
+    int         array;            // pack into pages of the same size and write them as a single
+                                  // texture array (DDS), see atlasc_sprite.layer
+    int64_t     budget;           // bytes (RGBA8), if set: the largest scale (up to `scale`) that
+                                  // makes the atlas fit is used, see atlasc_atlas_data.scale
+    int         nine_slice;       // collapse uniform stretch regions of sprites with slice insets
+    int         dedupe;           // pack identical, mirrored and rotated sprites once, see
+                                  // atlasc_sprite.transform
+    int         palettes;         // store recolored sprites once as palette indices, see
+                                  // atlasc_sprite.palette
+    const char* cache_dir;        // optional: keeps analysis results (trimmed rect, mesh) of
+                                  // sprite alpha masks in this directory for next builds
+    int64_t     cache_limit;      // bytes, if set: the least used files in cache_dir are removed
+                                  // after the build to keep it under the limit
+    int         nearest;          // resize with nearest filter (pixel art). integer upscales
+                                  // always use it
+    int         format;           // ATLASC_FORMAT_*, 16bit formats are written as DDS
+    int         dither;           // ATLASC_DITHER_*, for 16bit formats
+    int         hit_mask;         // cell size in pixels (1 = pixel accurate), if set: 1bit masks
+                                  // of opaque pixels for hit testing, see atlasc_sprite.hit_mask
+    int         colliders;        // max vertices of a convex piece (3..255), if set: the outline
+                                  // (simplified to max_verts_per_mesh) is decomposed into convex
+                                  // pieces for physics, see atlasc_sprite.collider_pts
+    int         check_mesh;       // measure how meshes cover the opaque pixels, see
+                                  // atlasc_sprite.mesh_uncovered. atlasc_make fails if they don't
+    int         clear_transparent;    // zero the color of fully transparent pixels (after rescale).
+                                      // off keeps color bleed painted under alpha 0
+    int         no_resize_cache;    // allocate resampling memory on every resize instead of
+                                    // reusing it (to measure the reuse, see atlasc-bench)
 } atlasc_args;
 
+// raw input images: 32bpp RGBA pixels after this header. headerless .raw/.rgba files are also
+// accepted if the size is in the filename: walk_0001_64x64.rgba
+#define ATLASC_RAW_MAGIC 0x57415241    // 'ARAW'
+
+typedef struct atlasc_raw_header {
+    uint32_t magic;
+    uint32_t width;
+    uint32_t height;
+} atlasc_raw_header;
+
 typedef struct atlasc_image_data {
     uint8_t* pixels;    // only supports 32bpp RGBA format
     int      width;
     int      height;
+    int      slice[4];    // nine-slice insets: left, top, right, bottom (0 = none)
 } atlasc_image_data;
 
 typedef struct atlasc_args_frommem {
@@ -40,13 +98,30 @@ typedef struct atlasc_args_files {
     char**      in_filepaths;
     int         num_files;
     const char* out_filepath;    // not required for `atlasc_make_in_memory`
+    const char* patch_from;      // optional: previous build's descriptor, writes <out>.patch that
+                                 // updates previous outputs to the new ones (see atlasc-reader.h)
+    int64_t     max_memory;      // optional: bytes for decoding input images in parallel, defaults
+                                 // to what's left under the cgroup memory limit (linux)
 } atlasc_args_files;
 
+// sprite transforms (atlasc_sprite.transform): how a sprite is made from the pixels in its
+// sheet_rect. to map a point of the sprite (relative to sprite_rect.min) into sheet_rect:
+//      FLIP_X: x = width - x, FLIP_Y: y = height - y, then ROTATE: (x, y) = (y, width - x)
+// width and height are the sprite_rect size, sheet_rect is rotated if ROTATE is set
+#define ATLASC_TRANSFORM_FLIP_X 0x1
+#define ATLASC_TRANSFORM_FLIP_Y 0x2
+#define ATLASC_TRANSFORM_ROTATE 0x4
+
 typedef struct atlasc_sprite {
     uint8_t* src_image;      // RGBA image buffer (32bpp)
     sx_ivec2 src_size;       // widthxheight
     sx_irect sprite_rect;    // cropped rectangle relative to sprite's source image (pixels)
     sx_irect sheet_rect;     // rectangle in final sheet (pixels)
+    int      layer;          // page (texture array layer) that sheet_rect is in
+    int      slice[4];       // nine-slice insets (left, top, right, bottom) relative to src_size
+    int      transform;      // ATLASC_TRANSFORM_* flags, sheet_rect can be shared (--dedupe)
+    int      palette;        // index into atlasc_atlas_data.palettes, -1 for RGBA sprites. the
+                             // texels of indexed sprites are: R = palette index, A = 255
 
     // sprite-mesh data (if flag is set. see atlas_args)
     uint16_t  num_tris;
@@ -54,14 +129,72 @@ typedef struct atlasc_sprite {
     sx_ivec2* pts;
     sx_ivec2* uvs;
     uint16_t* tris;
+
+    // quantized mesh positions (x, y pairs) relative to sprite_rect.vmin, only if `quantize_mesh`
+    // is set. replaces `pts` and `uvs`: pt = qpt + sprite_rect.vmin, uv = qpt + sheet_rect.vmin +
+    // padding
+    int16_t* qpts;
+
+    // mesh coverage, only if `check_mesh` is set: opaque (thresholded) pixels that the mesh doesn't
+    // touch, and pixels that the mesh touches per opaque pixel
+    int   mesh_uncovered;
+    float mesh_overdraw;
+
+    // 1bit thresholded alpha of sprite_rect, only if `hit_mask` is set. a bit is set if any pixel
+    // of its cell (hit_mask x hit_mask pixels, from sprite_rect.vmin) is opaque. rows start on
+    // byte boundaries, LSB first: bit (x, y) = hit_mask[y * ((cells_x + 7) / 8) + x / 8] >> (x % 8)
+    uint8_t* hit_mask;
+
+    // convex pieces of the outline, only if `colliders` is set. points of all pieces are stored one
+    // after another, relative to the source image (like pts). piece i has collider_sizes[i] points
+    // in counter-clockwise order with y up (clockwise in image coordinates)
+    int       num_colliders;
+    int       num_collider_pts;
+    uint8_t*  collider_sizes;
+    sx_ivec2* collider_pts;
 } atlasc_sprite;
 
+// RGBA8 colors, R in the lowest byte
+typedef struct atlasc_palette {
+    uint32_t colors[256];
+    int      num_colors;
+} atlasc_palette;
+
 typedef struct atlasc_atlas_data {
     atlasc_sprite* sprites;
     int            num_sprites;
-    atlasc_image_data atlas_image;
+    atlasc_image_data atlas_image;    // holds num_layers pages of widthxheight, one after another
+    int               num_layers;
+    float             scale;    // scale that was applied to the images
+    int               format;   // ATLASC_FORMAT_*. atlas_image is still RGBA8, with values
+                                // quantized to the precision of the format
+    atlasc_palette*   palettes;
+    int               num_palettes;
 } atlasc_atlas_data;
 
+// host job system (see atlasc_set_job_callbacks). dispatch runs `task_fn(index, task_user)` for
+// indices [0, count) on the host's workers and returns a handle, wait blocks until they are done.
+// the tasks are independent and each may run for a while, as they pull work from a shared queue
+typedef void(atlasc_task_cb)(int index, void* task_user);
+typedef void*(atlasc_dispatch_cb)(atlasc_task_cb* task_fn, void* task_user, int count, void* ctx);
+typedef void(atlasc_wait_cb)(void* handle, void* ctx);
+
+// profiler zones (see atlasc_set_profile_callbacks), begin and end are called in pairs on the same
+// thread and zones can be nested. names are static strings:
+//      stages:     "decode", "analysis", "colliders", "pack", "blit", "encode", "descriptor"
+//      per sprite: "decode_image", "sprite", "mesh", "collider"
+// thread_id is the os thread id. if a build fails, its open zones are still ended, with counters
+// of the work that was completed
+typedef struct atlasc_zone_counters {
+    int64_t items;    // images/sprites/triangles processed, 0 if it doesn't apply
+    int64_t bytes;    // bytes processed (decoded pixels, image file size for "encode", ...), 0 if
+                      // it doesn't apply
+} atlasc_zone_counters;
+
+typedef void(atlasc_zone_begin_cb)(const char* name, uint32_t thread_id, void* ctx);
+typedef void(atlasc_zone_end_cb)(const char* name, uint32_t thread_id,
+                                 const atlasc_zone_counters* counters, void* ctx);
+
 #ifndef ATLASC__HIDE_API
 #ifdef __cplusplus
 extern "C" {
@@ -73,6 +206,17 @@ void atlasc_set_alloc_callbacks(void* (*malloc_fn)(size_t size, void* ctx),
                                 void (*free_fn)(void* ptr, void* ctx),
                                 void* (*realloc_fn)(void* ptr, size_t size, void* ctx), void* ctx);
 
+// run the parallel stages on the host's job system instead of atlasc's own threads: decoding of
+// input files (atlasc_make, atlasc_make_inmem), collider decomposition and png optimization.
+// `num_workers` is the most tasks that are dispatched at once. pass NULLs to use the built-in pool
+void atlasc_set_job_callbacks(atlasc_dispatch_cb* dispatch_fn, atlasc_wait_cb* wait_fn,
+                              int num_workers, void* ctx);
+
+// report the stages of builds to the host's profiler, pass NULLs to disable (default). there is no
+// overhead without callbacks
+void atlasc_set_profile_callbacks(atlasc_zone_begin_cb* begin_fn, atlasc_zone_end_cb* end_fn,
+                                  void* ctx);
+
 // receives arguments (input filepaths) and writes 32bpp PNG to out_filepath
 bool atlasc_make(const atlasc_args_files* args);
 
@@ -81,6 +225,7 @@ bool atlasc_make(const atlasc_args_files* args);
 atlasc_atlas_data* atlasc_make_inmem(const atlasc_args_files* args);
 
 // recevies input image buffers and common arguments
+// takes the ownership of the image pixels (freed with the allocator), also if the build fails
 // you have to free the data after use with `atlasc_free`
 atlasc_atlas_data* atlasc_make_inmem_frommem(const atlasc_args_frommem* args);
 
@@ -12,18 +12,48 @@
 
 #include "../include/atlasc.h"
 
+#define ATLASC_READER_STATIC
+#define ATLASC_READER_IMPLEMENTATION
+#include "../include/atlasc-reader.h"
+
 #include "sx/allocator.h"
 #include "sx/array.h"
+#include "sx/atomic.h"
 #include "sx/cmdline.h"
+#include "sx/hash.h"
 #include "sx/io.h"
+#include "sx/jobs.h"
 #include "sx/math.h"
 #include "sx/os.h"
 #include "sx/string.h"
+#include "sx/threads.h"
 
 #include "delaunay/delaunay.h"
 
 #include <limits.h>
 #include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+
+#if SX_PLATFORM_WINDOWS
+#    include <io.h>
+#    include <process.h>
+#    include <sys/utime.h>
+#    define atlasc__getpid() _getpid()
+#    define atlasc__touch(_path) _utime(_path, NULL)
+#else
+#    include <dirent.h>
+#    include <unistd.h>
+#    include <utime.h>
+#    define atlasc__getpid() getpid()
+#    define atlasc__touch(_path) utime(_path, NULL)
+#endif
+
+#if SX_CPU_X86 && (defined(__SSE2__) || defined(_M_X64))
+#    include <emmintrin.h>
+#    define ATLASC__SSE2 1
+#endif
 
 static const sx_alloc* g_alloc;
 typedef void* (*atlasc__malloc_cb)(size_t size, void* ctx);
@@ -53,6 +83,25 @@ static atlasc__free_cb g_free_fn = atlasc__free;
 static atlasc__realloc_cb g_realloc_fn = atlasc__realloc;
 static void* g_alloc_ctx;
 
+// profiler zones (atlasc_set_profile_callbacks), they are a single branch without callbacks
+static atlasc_zone_begin_cb* g_zone_begin_fn;
+static atlasc_zone_end_cb* g_zone_end_fn;
+static void* g_profile_ctx;
+
+#define ATLASC__ZONE_BEGIN(_name)                                   \
+    do {                                                            \
+        if (g_zone_begin_fn)                                        \
+            g_zone_begin_fn(_name, sx_thread_tid(), g_profile_ctx); \
+    } while (0)
+
+#define ATLASC__ZONE_END(_name, _items, _bytes)                                          \
+    do {                                                                                 \
+        if (g_zone_end_fn) {                                                             \
+            atlasc_zone_counters counters = { (int64_t)(_items), (int64_t)(_bytes) };    \
+            g_zone_end_fn(_name, sx_thread_tid(), &counters, g_profile_ctx);             \
+        }                                                                                \
+    } while (0)
+
 #define STB_IMAGE_IMPLEMENTATION
 #define STB_IMAGE_STATIC
 #define STBI_MALLOC(sz) atlasc__malloc(sz, g_alloc_ctx)
@@ -68,8 +117,32 @@ static void* g_alloc_ctx;
 #define STBIW_FREE(p) atlasc__free(p, g_alloc_ctx)
 #include "stb/stb_image_write.h"
 
-#define STBIR_MALLOC(size, context) atlasc__malloc(size, g_alloc_ctx)
-#define STBIR_FREE(ptr, context) atlasc__free(ptr, g_alloc_ctx)
+// stb_image_resize allocates the filters and buffers of a resize at once. with a scratch as alloc
+// context, the memory is kept for the next resizes instead (animation frames have the same size)
+typedef struct atlasc__resize_scratch {
+    void* mem;
+    size_t size;
+} atlasc__resize_scratch;
+
+static void* atlasc__resize_alloc(size_t size, void* context)
+{
+    atlasc__resize_scratch* scratch = context;
+    if (!scratch)
+        return atlasc__malloc(size, g_alloc_ctx);
+    if (size > scratch->size) {
+        atlasc__free(scratch->mem, g_alloc_ctx);
+        scratch->mem = atlasc__malloc(size, g_alloc_ctx);
+        scratch->size = scratch->mem ? size : 0;
+    }
+    return scratch->mem;
+}
+
+#define STBIR_MALLOC(size, context) atlasc__resize_alloc(size, context)
+#define STBIR_FREE(ptr, context)            \
+    do {                                    \
+        if (!(context))                     \
+            atlasc__free(ptr, g_alloc_ctx); \
+    } while (0)
 #define STBIR_ASSET(_b) sx_assert(_b)
 #define STB_IMAGE_RESIZE_IMPLEMENTATION
 #include "stb/stb_image_resize.h"
@@ -128,6 +201,22 @@ static void atlasc__free_sprites(atlasc_sprite* sprites, int num_sprites)
         if (sprites[i].uvs) {
             atlasc__free(sprites[i].uvs, g_alloc_ctx);
         }
+
+        if (sprites[i].qpts) {
+            atlasc__free(sprites[i].qpts, g_alloc_ctx);
+        }
+
+        if (sprites[i].hit_mask) {
+            atlasc__free(sprites[i].hit_mask, g_alloc_ctx);
+        }
+
+        if (sprites[i].collider_sizes) {
+            atlasc__free(sprites[i].collider_sizes, g_alloc_ctx);
+        }
+
+        if (sprites[i].collider_pts) {
+            atlasc__free(sprites[i].collider_pts, g_alloc_ctx);
+        }
     }
     atlasc__free(sprites, g_alloc_ctx);
 }
@@ -148,6 +237,52 @@ static void atlasc__blit(uint8_t* dst, int dst_x, int dst_y, int dst_pitch, cons
     }
 }
 
+static inline sx_ivec2 atlasc__sprite_pt(const atlasc_sprite* spr, int index)
+{
+    if (spr->qpts) {
+        return sx_ivec2i(spr->sprite_rect.xmin + spr->qpts[index * 2],
+                         spr->sprite_rect.ymin + spr->qpts[index * 2 + 1]);
+    }
+    return spr->pts[index];
+}
+
+// maps a point of a w x h sprite to the packed pixels it's made from (see ATLASC_TRANSFORM_*)
+// pass size-1 for pixel coordinates
+static inline sx_ivec2 atlasc__transform_pt(sx_ivec2 pt, int w, int h, int transform)
+{
+    if (transform & ATLASC_TRANSFORM_FLIP_X)
+        pt.x = w - pt.x;
+    if (transform & ATLASC_TRANSFORM_FLIP_Y)
+        pt.y = h - pt.y;
+    return (transform & ATLASC_TRANSFORM_ROTATE) ? sx_ivec2i(pt.y, w - pt.x) : pt;
+}
+
+static inline sx_ivec2 atlasc__sprite_uv(const atlasc_sprite* spr, int index, int padding)
+{
+    if (spr->qpts) {
+        sx_ivec2 qpt = sx_ivec2i(spr->qpts[index * 2], spr->qpts[index * 2 + 1]);
+        sx_ivec2 pt = atlasc__transform_pt(qpt, spr->sprite_rect.xmax - spr->sprite_rect.xmin,
+                                           spr->sprite_rect.ymax - spr->sprite_rect.ymin,
+                                           spr->transform);
+        return sx_ivec2i(spr->sheet_rect.xmin + padding + pt.x,
+                         spr->sheet_rect.ymin + padding + pt.y);
+    }
+    return spr->uvs[index];
+}
+
+static int atlasc__num_layers(const atlasc_sprite* sprites, int num_sprites)
+{
+    int num_layers = 1;
+    for (int i = 0; i < num_sprites; i++)
+        num_layers = sx_max(num_layers, sprites[i].layer + 1);
+    return num_layers;
+}
+
+static bool atlasc__has_slice(const int slice[4])
+{
+    return slice[0] || slice[1] || slice[2] || slice[3];
+}
+
 static inline sx_vec2 atlasc__itof2(const s2o_point p)
 {
     return sx_vec2f((float)p.x, (float)p.y);
@@ -249,8 +384,10 @@ static void atlasc__fix_outline_pts(const uint8_t* thresholded, int tw, int th,
     }
 }
 
-static void atlasc__make_mesh(atlasc_sprite* spr, const s2o_point* pts, int pt_count, int max_verts,
-                              const uint8_t* thresholded, int width, int height)
+// simplifies the outline down to `max_verts`, returns the points and their count in `num_verts`
+static s2o_point* atlasc__simplify_outline(const s2o_point* pts, int pt_count, int max_verts,
+                                           const uint8_t* thresholded, int width, int height,
+                                           int* num_verts_out)
 {
     const float delta = 0.5f;
     const float threshold_start = 0.5f;
@@ -260,7 +397,7 @@ static void atlasc__make_mesh(atlasc_sprite* spr, const s2o_point* pts, int pt_c
     s2o_point* temp_pts = atlasc__malloc(sizeof(s2o_point) * pt_count, g_alloc_ctx);
     if (!temp_pts) {
         sx_out_of_memory();
-        return;
+        return NULL;
     }
 
     if (width > 1 && height > 1) {
@@ -278,6 +415,12 @@ static void atlasc__make_mesh(atlasc_sprite* spr, const s2o_point* pts, int pt_c
         num_verts = pt_count;
     }
 
+    *num_verts_out = num_verts;
+    return temp_pts;
+}
+
+static void atlasc__make_mesh(atlasc_sprite* spr, const s2o_point* temp_pts, int num_verts)
+{
     // triangulate
     del_point2d_t* dpts = atlasc__malloc(sizeof(del_point2d_t) * num_verts, g_alloc_ctx);
     if (!dpts) {
@@ -308,96 +451,3920 @@ static void atlasc__make_mesh(atlasc_sprite* spr, const s2o_point* pts, int pt_c
         spr->tris[index + 1] = (uint16_t)tris->tris[index + 1];
         spr->tris[index + 2] = (uint16_t)tris->tris[index + 2];
     }
-    for (unsigned int i = 0; i < tris->num_points; i++) {
-        spr->pts[i] = sx_ivec2i((int)tris->points[i].x, (int)tris->points[i].y);
+    for (unsigned int i = 0; i < tris->num_points; i++) {
+        spr->pts[i] = sx_ivec2i((int)tris->points[i].x, (int)tris->points[i].y);
+    }
+    spr->num_tris = (uint16_t)tris->num_triangles;
+    spr->num_points = (int)tris->num_points;
+
+    tri_delaunay2d_release(tris);
+}
+
+static inline int64_t atlasc__cross(sx_ivec2 a, sx_ivec2 b, sx_ivec2 c)
+{
+    return (int64_t)(b.x - a.x) * (c.y - b.y) - (int64_t)(b.y - a.y) * (c.x - b.x);
+}
+
+// removes repeated and collinear points of a closed polygon, returns the new count
+static int atlasc__polygon_cleanup(sx_ivec2* pts, int count)
+{
+    bool removed = true;
+    while (removed && count >= 3) {
+        removed = false;
+        for (int i = 0; i < count && count >= 3; i++) {
+            sx_ivec2 prev = pts[(i + count - 1) % count];
+            sx_ivec2 next = pts[(i + 1) % count];
+            if (atlasc__cross(prev, pts[i], next) == 0) {
+                sx_memmove(&pts[i], &pts[i + 1], sizeof(sx_ivec2) * (count - i - 1));
+                count--;
+                removed = true;
+            }
+        }
+    }
+    return count;
+}
+
+static bool atlasc__in_triangle(sx_ivec2 pt, sx_ivec2 a, sx_ivec2 b, sx_ivec2 c)
+{
+    return atlasc__cross(a, b, pt) >= 0 && atlasc__cross(b, c, pt) >= 0 &&
+           atlasc__cross(c, a, pt) >= 0;
+}
+
+// merges convex pieces `a` and `b` over their shared edge into `merged`, returns the point count of
+// the result, 0 if they don't share an edge or the result is concave or has more than `max_verts`
+static int atlasc__merge_pieces(const sx_ivec2* pts, const int* a, int na, const int* b, int nb,
+                                int max_verts, int* merged)
+{
+    for (int ia = 0; ia < na; ia++) {
+        int u = a[ia];
+        int v = a[(ia + 1) % na];
+        for (int ib = 0; ib < nb; ib++) {
+            if (b[ib] != v || b[(ib + 1) % nb] != u)
+                continue;
+
+            // a from v around to u, then b from after u to before v
+            int count = 0;
+            for (int k = 1; k <= na; k++)
+                merged[count++] = a[(ia + k) % na];
+            for (int k = 2; k < nb; k++)
+                merged[count++] = b[(ib + k) % nb];
+
+            // collinear points on the removed edge's ends are dropped
+            int num_left = 0;
+            for (int k = 0; k < count; k++) {
+                int64_t c = atlasc__cross(pts[merged[(k + count - 1) % count]], pts[merged[k]],
+                                          pts[merged[(k + 1) % count]]);
+                if (c < 0)
+                    return 0;
+                if (c > 0)
+                    merged[num_left++] = merged[k];
+            }
+            return num_left <= max_verts ? num_left : 0;
+        }
+    }
+    return 0;
+}
+
+// hertel-mehlhorn: ear clipping triangulation of the simplified outline (stored in collider_pts),
+// then diagonals are removed as long as the merged pieces stay convex and within `max_verts`.
+// self-intersecting outlines still make convex pieces, though they may overlap
+static bool atlasc__decompose_outline(atlasc_sprite* spr, int max_verts)
+{
+    sx_ivec2* pts = spr->collider_pts;
+    int count = atlasc__polygon_cleanup(pts, spr->num_collider_pts);
+    spr->collider_pts = NULL;
+    spr->num_collider_pts = 0;
+    if (count < 3) {
+        atlasc__free(pts, g_alloc_ctx);
+        return true;
+    }
+
+    int64_t area = 0;
+    for (int i = 0; i < count; i++)
+        area += (int64_t)pts[i].x * pts[(i + 1) % count].y -
+                (int64_t)pts[(i + 1) % count].x * pts[i].y;
+    if (area < 0) {
+        for (int i = 0; i < count / 2; i++)
+            sx_swap(pts[i], pts[count - i - 1], sx_ivec2);
+    }
+
+    int* remaining = atlasc__malloc(sizeof(int) * count, g_alloc_ctx);
+    int* pieces = atlasc__malloc(sizeof(int) * max_verts * count, g_alloc_ctx);
+    int* sizes = atlasc__malloc(sizeof(int) * count, g_alloc_ctx);
+    int* merged = atlasc__malloc(sizeof(int) * count * 2, g_alloc_ctx);
+    if (!remaining || !pieces || !sizes || !merged) {
+        atlasc__free(remaining, g_alloc_ctx);
+        atlasc__free(pieces, g_alloc_ctx);
+        atlasc__free(sizes, g_alloc_ctx);
+        atlasc__free(merged, g_alloc_ctx);
+        atlasc__free(pts, g_alloc_ctx);
+        return false;
+    }
+
+    // ear clipping, falls back to any convex corner (or the first one) if there are no ears left
+    int num_pieces = 0;
+    for (int i = 0; i < count; i++)
+        remaining[i] = i;
+    for (int m = count; m >= 3; m--) {
+        int ear = -1;
+        int convex = -1;
+        for (int i = 0; i < m && ear == -1; i++) {
+            sx_ivec2 a = pts[remaining[(i + m - 1) % m]];
+            sx_ivec2 b = pts[remaining[i]];
+            sx_ivec2 c = pts[remaining[(i + 1) % m]];
+            if (atlasc__cross(a, b, c) <= 0)
+                continue;
+            convex = convex == -1 ? i : convex;
+            bool empty = true;
+            for (int k = 0; k < m && empty; k++) {
+                sx_ivec2 pt = pts[remaining[k]];
+                bool corner = (pt.x == a.x && pt.y == a.y) || (pt.x == b.x && pt.y == b.y) ||
+                              (pt.x == c.x && pt.y == c.y);
+                empty = corner || !atlasc__in_triangle(pt, a, b, c);
+            }
+            ear = empty ? i : -1;
+        }
+        ear = ear != -1 ? ear : (convex != -1 ? convex : 0);
+
+        int* tri = &pieces[num_pieces * max_verts];
+        tri[0] = remaining[(ear + m - 1) % m];
+        tri[1] = remaining[ear];
+        tri[2] = remaining[(ear + 1) % m];
+        if (atlasc__cross(pts[tri[0]], pts[tri[1]], pts[tri[2]]) > 0)
+            sizes[num_pieces++] = 3;
+        sx_memmove(&remaining[ear], &remaining[ear + 1], sizeof(int) * (m - ear - 1));
+    }
+
+    // remove diagonals until no more pieces can be merged
+    bool changed = max_verts > 3;
+    while (changed) {
+        changed = false;
+        for (int a = 0; a < num_pieces; a++) {
+            for (int b = a + 1; b < num_pieces && sizes[a]; b++) {
+                if (!sizes[b])
+                    continue;
+                int n = atlasc__merge_pieces(pts, &pieces[a * max_verts], sizes[a],
+                                             &pieces[b * max_verts], sizes[b], max_verts, merged);
+                if (n) {
+                    sx_memcpy(&pieces[a * max_verts], merged, sizeof(int) * n);
+                    sizes[a] = n;
+                    sizes[b] = 0;
+                    changed = true;
+                }
+            }
+        }
+    }
+
+    int num_colliders = 0;
+    int num_collider_pts = 0;
+    for (int i = 0; i < num_pieces; i++) {
+        num_colliders += sizes[i] ? 1 : 0;
+        num_collider_pts += sizes[i];
+    }
+    spr->collider_sizes = atlasc__malloc(num_colliders, g_alloc_ctx);
+    spr->collider_pts = atlasc__malloc(sizeof(sx_ivec2) * num_collider_pts, g_alloc_ctx);
+    bool r = spr->collider_sizes && spr->collider_pts;
+    if (r) {
+        for (int i = 0; i < num_pieces; i++) {
+            if (!sizes[i])
+                continue;
+            spr->collider_sizes[spr->num_colliders++] = (uint8_t)sizes[i];
+            for (int k = 0; k < sizes[i]; k++)
+                spr->collider_pts[spr->num_collider_pts++] = pts[pieces[i * max_verts + k]];
+        }
+    }
+
+    atlasc__free(remaining, g_alloc_ctx);
+    atlasc__free(pieces, g_alloc_ctx);
+    atlasc__free(sizes, g_alloc_ctx);
+    atlasc__free(merged, g_alloc_ctx);
+    atlasc__free(pts, g_alloc_ctx);
+    return r;
+}
+
+typedef struct atlasc__collider_job_data {
+    atlasc_sprite* sprites;
+    int max_verts;
+    sx_atomic_int failed;
+} atlasc__collider_job_data;
+
+static void atlasc__collider_job(int index, void* user)
+{
+    atlasc__collider_job_data* job = user;
+    atlasc_sprite* spr = &job->sprites[index];
+    if (!spr->collider_pts)
+        return;
+    ATLASC__ZONE_BEGIN("collider");
+    if (!atlasc__decompose_outline(spr, job->max_verts))
+        sx_atomic_xchg(&job->failed, 1);
+    ATLASC__ZONE_END("collider", spr->num_colliders, 0);
+}
+
+#define ATLASC__LZ_HASH_BITS 16
+#define ATLASC__LZ_MIN_MATCH 4
+#define ATLASC__LZ_LAST_LITERALS 5    // last 5 bytes of the block are always literals
+#define ATLASC__LZ_MF_LIMIT 12        // last match must start 12 bytes before the end of block
+
+static inline int atlasc__lz_bound(int size)
+{
+    return size + size / 255 + 16;
+}
+
+static inline uint32_t atlasc__lz_read32(const uint8_t* p)
+{
+    uint32_t v;
+    sx_memcpy(&v, p, sizeof(v));
+    return v;
+}
+
+static inline uint8_t* atlasc__lz_write_len(uint8_t* op, int len)
+{
+    for (; len >= 255; len -= 255)
+        *op++ = 255;
+    *op++ = (uint8_t)len;
+    return op;
+}
+
+static uint8_t* atlasc__lz_write_seq(uint8_t* op, const uint8_t* literals, int num_literals,
+                                     int offset, int match_len)
+{
+    uint8_t* token = op++;
+    *token = (uint8_t)(sx_min(num_literals, 15) << 4);
+    if (num_literals >= 15)
+        op = atlasc__lz_write_len(op, num_literals - 15);
+    sx_memcpy(op, literals, num_literals);
+    op += num_literals;
+
+    if (match_len) {
+        int ml = match_len - ATLASC__LZ_MIN_MATCH;
+        *op++ = (uint8_t)(offset & 0xff);
+        *op++ = (uint8_t)(offset >> 8);
+        *token |= (uint8_t)sx_min(ml, 15);
+        if (ml >= 15)
+            op = atlasc__lz_write_len(op, ml - 15);
+    }
+    return op;
+}
+
+// greedy LZ4 block compressor, dst must be at least `atlasc__lz_bound` bytes
+// we don't spend more time on searching for better matches, because the decompression speed is
+// the same and the descriptors are mostly small text/ints that compress well anyway
+static int atlasc__lz_compress(const uint8_t* src, int size, uint8_t* dst)
+{
+    uint8_t* op = dst;
+    int anchor = 0;
+
+    if (size > ATLASC__LZ_MF_LIMIT) {
+        int* table = atlasc__malloc(sizeof(int) << ATLASC__LZ_HASH_BITS, g_alloc_ctx);
+        if (!table) {
+            sx_out_of_memory();
+            return 0;
+        }
+        sx_memset(table, 0xff, sizeof(int) << ATLASC__LZ_HASH_BITS);
+
+        const int match_limit = size - ATLASC__LZ_LAST_LITERALS;
+        int ip = 0;
+        while (ip <= size - ATLASC__LZ_MF_LIMIT) {
+            uint32_t seq = atlasc__lz_read32(src + ip);
+            uint32_t h = (seq * 2654435761u) >> (32 - ATLASC__LZ_HASH_BITS);
+            int ref = table[h];
+            table[h] = ip;
+
+            if (ref < 0 || ip - ref > UINT16_MAX || atlasc__lz_read32(src + ref) != seq) {
+                ip++;
+                continue;
+            }
+
+            // extend the match backwards into pending literals, and then forward
+            while (ip > anchor && ref > 0 && src[ip - 1] == src[ref - 1]) {
+                ip--;
+                ref--;
+            }
+            int len = ATLASC__LZ_MIN_MATCH;
+            while (ip + len < match_limit && src[ip + len] == src[ref + len])
+                len++;
+
+            op = atlasc__lz_write_seq(op, src + anchor, ip - anchor, ip - ref, len);
+            ip += len;
+            anchor = ip;
+        }
+
+        atlasc__free(table, g_alloc_ctx);
+    }
+
+    op = atlasc__lz_write_seq(op, src + anchor, size - anchor, 0, 0);
+    return (int)(op - dst);
+}
+
+// writes descriptor data to file, wraps it in the compressed container if it's requested
+static bool atlasc__write_desc(const char* filepath, const void* data, int size, bool compress)
+{
+    uint8_t* compressed = NULL;
+    atlasc_lz_header hdr = { .magic = ATLASC_LZ_MAGIC, .size = (uint32_t)size };
+    if (compress) {
+        compressed = atlasc__malloc(atlasc__lz_bound(size), g_alloc_ctx);
+        if (!compressed) {
+            sx_out_of_memory();
+            return false;
+        }
+        // a block has at least one token, zero means that compression failed
+        int compressed_size = atlasc__lz_compress(data, size, compressed);
+        if (compressed_size == 0) {
+            atlasc__free(compressed, g_alloc_ctx);
+            return false;
+        }
+        hdr.compressed_size = (uint32_t)compressed_size;
+    }
+
+    sx_file_writer writer;
+    if (!sx_file_open_writer(&writer, filepath, 0)) {
+        printf("could not open file for writing: %s\n", filepath);
+        if (compressed)
+            atlasc__free(compressed, g_alloc_ctx);
+        return false;
+    }
+    if (compressed) {
+        sx_file_write_var(&writer, hdr);
+        sx_file_write(&writer, compressed, (int)hdr.compressed_size);
+        atlasc__free(compressed, g_alloc_ctx);
+    } else {
+        sx_file_write(&writer, data, size);
+    }
+    sx_file_close_writer(&writer);
+    return true;
+}
+
+static bool atlasc__write_json(sjson_context* jctx, sjson_node* jroot, sx_mem_writer* out)
+{
+    char* jout = sjson_encode(jctx, jroot);
+    if (!jout) {
+        sjson_destroy_context(jctx);
+        return false;
+    }
+
+    sx_mem_write(out, jout, sx_strlen(jout));
+
+    sjson_free_string(jctx, jout);
+    sjson_destroy_context(jctx);
+    return true;
+}
+
+// sprite names are split into directory, prefix, frame number and extension. consecutive sprites
+// that only differ by frame number (walk_0001.png, walk_0002.png, ...) are merged into a single
+// sequence, so descriptors keep one entry per animation instead of a full path per frame
+typedef struct atlasc__name_seq {
+    int dir;       // index to string table
+    int prefix;    // index to string table
+    int ext;       // index to string table
+    int start;     // frame number of the first sprite
+    int count;     // number of sprites (frames)
+    int digits;    // minimum digits of frame numbers (zero padded), 0 if names have no number
+    int first_sprite;
+} atlasc__name_seq;
+
+typedef struct atlasc__name_table {
+    char** strs;                // sx_array: unique strings
+    sx_hashtbl* str_tbl;        // fnv32(str) -> index to strs
+    atlasc__name_seq* seqs;     // sx_array
+    int* sprite_seqs;           // sx_array: sequence index of each sprite
+} atlasc__name_table;
+
+// returns the index of the string, -1 if out of memory
+static int atlasc__name_table_intern(atlasc__name_table* tbl, const char* str, int len)
+{
+    uint32_t h = sx_hash_fnv32(str, (size_t)len);
+    int index = sx_hashtbl_find_get(tbl->str_tbl, h, -1);
+    if (index >= 0 && (int)sx_strlen(tbl->strs[index]) == len &&
+        sx_memcmp(tbl->strs[index], str, len) == 0) {
+        return index;
+    } else if (index >= 0) {
+        // hash collision, fallback to linear search
+        for (int i = 0, c = sx_array_count(tbl->strs); i < c; i++) {
+            if ((int)sx_strlen(tbl->strs[i]) == len && sx_memcmp(tbl->strs[i], str, len) == 0)
+                return i;
+        }
+    }
+
+    char* s = atlasc__malloc(len + 1, g_alloc_ctx);
+    if (!s) {
+        sx_out_of_memory();
+        return -1;
+    }
+    sx_memcpy(s, str, len);
+    s[len] = '\0';
+    index = sx_array_count(tbl->strs);
+    sx_array_push(g_alloc, tbl->strs, s);
+    if (sx_hashtbl_find(tbl->str_tbl, h) < 0)
+        sx_hashtbl_add_and_grow(tbl->str_tbl, h, index, g_alloc);
+    return index;
+}
+
+static void atlasc__name_table_release(atlasc__name_table* tbl)
+{
+    for (int i = 0, c = sx_array_count(tbl->strs); i < c; i++)
+        atlasc__free(tbl->strs[i], g_alloc_ctx);
+    sx_array_free(g_alloc, tbl->strs);
+    sx_array_free(g_alloc, tbl->seqs);
+    sx_array_free(g_alloc, tbl->sprite_seqs);
+    if (tbl->str_tbl)
+        sx_hashtbl_destroy(tbl->str_tbl, g_alloc);
+    sx_memset(tbl, 0x0, sizeof(*tbl));
+}
+
+static bool atlasc__name_table_build(atlasc__name_table* tbl, char** filepaths, int num_files)
+{
+    sx_memset(tbl, 0x0, sizeof(*tbl));
+    tbl->str_tbl = sx_hashtbl_create(g_alloc, 64);
+    if (!tbl->str_tbl) {
+        sx_out_of_memory();
+        return false;
+    }
+
+    char name[256];
+    char frame_str[32];
+    for (int i = 0; i < num_files; i++) {
+        sx_os_path_unixpath(name, sizeof(name), filepaths[i]);
+
+        // name = dir/prefix[number]ext
+        const char* filename = sx_strrchar(name, '/');
+        filename = filename ? filename + 1 : name;
+        const char* ext = sx_strrchar(filename, '.');
+        if (!ext)
+            ext = filename + sx_strlen(filename);
+        const char* digits = ext;
+        while (digits > filename && sx_isnumchar(digits[-1]) && (ext - digits) < 9)
+            digits--;
+
+        int dir_len = filename > name ? (int)(filename - name) - 1 : 0;
+        int dir = atlasc__name_table_intern(tbl, name, dir_len);
+        int prefix = atlasc__name_table_intern(tbl, filename, (int)(digits - filename));
+        int ext_idx = atlasc__name_table_intern(tbl, ext, sx_strlen(ext));
+        if (dir < 0 || prefix < 0 || ext_idx < 0) {
+            atlasc__name_table_release(tbl);
+            return false;
+        }
+        int num_digits = (int)(ext - digits);
+        int frame = 0;
+        if (num_digits) {
+            sx_strncpy(frame_str, sizeof(frame_str), digits, num_digits);
+            frame = sx_toint(frame_str);
+        }
+
+        // continue the last sequence if the frame number is the next in line and formatted
+        // the same way
+        int seq_count = sx_array_count(tbl->seqs);
+        if (seq_count > 0 && num_digits) {
+            atlasc__name_seq* seq = &tbl->seqs[seq_count - 1];
+            char next_str[32];
+            sx_snprintf(next_str, sizeof(next_str), "%0*d", seq->digits, seq->start + seq->count);
+            if (seq->digits && seq->dir == dir && seq->prefix == prefix && seq->ext == ext_idx &&
+                frame == seq->start + seq->count && sx_strequal(next_str, frame_str)) {
+                seq->count++;
+                sx_array_push(g_alloc, tbl->sprite_seqs, seq_count - 1);
+                continue;
+            }
+        }
+
+        atlasc__name_seq seq = { .dir = dir,
+                                 .prefix = prefix,
+                                 .ext = ext_idx,
+                                 .start = frame,
+                                 .count = 1,
+                                 .digits = num_digits,
+                                 .first_sprite = i };
+        sx_array_push(g_alloc, tbl->seqs, seq);
+        sx_array_push(g_alloc, tbl->sprite_seqs, seq_count);
+    }
+
+    return true;
+}
+
+// version 1 schema: array of sprite objects, mesh vertices are nested [x,y] arrays
+static bool atlasc__save_json(const atlasc_args_files* args, const atlasc_sprite* sprites,
+                              int num_sprites, const atlasc_palette* palettes, int num_palettes,
+                              const char* image_filename, int dst_w, int dst_h, sx_mem_writer* out)
+{
+    sjson_context* jctx = sjson_create_context(0, 0, (void*)g_alloc);
+    if (!jctx) {
+        sx_assert(0);
+        return false;
+    }
+
+    sjson_node* jroot = sjson_mkobject(jctx);
+    sjson_put_string(jctx, jroot, "image", image_filename);
+    sjson_put_int(jctx, jroot, "image_width", dst_w);
+    sjson_put_int(jctx, jroot, "image_height", dst_h);
+    if (args->common.array)
+        sjson_put_int(jctx, jroot, "num_layers", atlasc__num_layers(sprites, num_sprites));
+
+    sjson_node* jsprites = sjson_put_array(jctx, jroot, "sprites");
+    char name[256];
+    for (int i = 0; i < num_sprites; i++) {
+        const atlasc_sprite* spr = &sprites[i];
+        sjson_node* jsprite = sjson_mkobject(jctx);
+
+        sx_os_path_unixpath(name, sizeof(name), args->in_filepaths[i]);
+        sjson_put_string(jctx, jsprite, "name", name);
+        sjson_put_ints(jctx, jsprite, "size", spr->src_size.n, 2);
+        sjson_put_ints(jctx, jsprite, "sprite_rect", spr->sprite_rect.f, 4);
+        sjson_put_ints(jctx, jsprite, "sheet_rect", spr->sheet_rect.f, 4);
+        if (args->common.array)
+            sjson_put_int(jctx, jsprite, "layer", spr->layer);
+        if (atlasc__has_slice(spr->slice))
+            sjson_put_ints(jctx, jsprite, "slice", spr->slice, 4);
+        if (spr->transform)
+            sjson_put_int(jctx, jsprite, "transform", spr->transform);
+        if (spr->palette >= 0)
+            sjson_put_int(jctx, jsprite, "palette", spr->palette);
+
+        if (spr->num_tris) {
+            sjson_node* jmesh = sjson_put_obj(jctx, jsprite, "mesh");
+            sjson_put_int(jctx, jmesh, "num_tris", spr->num_tris);
+            sjson_put_int(jctx, jmesh, "num_vertices", spr->num_points);
+            sjson_put_uint16s(jctx, jmesh, "indices", spr->tris, (int)spr->num_tris * 3);
+            sjson_node* jverts = sjson_put_array(jctx, jmesh, "positions");
+            for (int v = 0; v < spr->num_points; v++) {
+                sx_ivec2 pt = atlasc__sprite_pt(spr, v);
+                sjson_node* jvert = sjson_mkarray(jctx);
+                sjson_append_element(jvert, sjson_mknumber(jctx, (double)pt.x));
+                sjson_append_element(jvert, sjson_mknumber(jctx, (double)pt.y));
+                sjson_append_element(jverts, jvert);
+            }
+
+            sjson_node* juvs = sjson_put_array(jctx, jmesh, "uvs");
+            for (int u = 0; u < spr->num_points; u++) {
+                sx_ivec2 uv = atlasc__sprite_uv(spr, u, args->common.padding);
+                sjson_node* juv = sjson_mkarray(jctx);
+                sjson_append_element(juv, sjson_mknumber(jctx, (double)uv.x));
+                sjson_append_element(juv, sjson_mknumber(jctx, (double)uv.y));
+                sjson_append_element(juvs, juv);
+            }
+        }
+
+        if (spr->num_colliders) {
+            sjson_node* jcolliders = sjson_put_array(jctx, jsprite, "colliders");
+            for (int c = 0, first = 0; c < spr->num_colliders; c++) {
+                sjson_node* jpiece = sjson_mkarray(jctx);
+                for (int v = first; v < first + spr->collider_sizes[c]; v++) {
+                    sx_ivec2 pt = spr->collider_pts[v];
+                    sjson_node* jvert = sjson_mkarray(jctx);
+                    sjson_append_element(jvert, sjson_mknumber(jctx, (double)pt.x));
+                    sjson_append_element(jvert, sjson_mknumber(jctx, (double)pt.y));
+                    sjson_append_element(jpiece, jvert);
+                }
+                sjson_append_element(jcolliders, jpiece);
+                first += spr->collider_sizes[c];
+            }
+        }
+
+        sjson_append_element(jsprites, jsprite);
+    }
+
+    if (num_palettes > 0) {
+        sjson_node* jpalettes = sjson_put_array(jctx, jroot, "palettes");
+        for (int i = 0; i < num_palettes; i++) {
+            sjson_node* jpalette = sjson_mkarray(jctx);
+            for (int k = 0; k < palettes[i].num_colors; k++) {
+                sjson_append_element(jpalette,
+                                     sjson_mknumber(jctx, (double)palettes[i].colors[k]));
+            }
+            sjson_append_element(jpalettes, jpalette);
+        }
+    }
+
+    return atlasc__write_json(jctx, jroot, out);
+}
+
+// version 2 (compact) schema: sprite fields are parallel arrays (struct-of-arrays) and all
+// vectors/rects are flattened into plain number arrays. mesh data of all sprites is concatenated
+// and addressed by per-sprite counts, so parsers don't have to allocate per vertex
+// sprite names are stored as sequences that reference a shared string table (see name table)
+// fields that are equal to their defaults are omitted:
+//      - "sprite_rects" is omitted if no sprite is trimmed (sprite_rect = [0, 0, width, height])
+//      - "meshes" is omitted if there are no sprite meshes
+//      - "colliders" is omitted if there are no convex pieces (--colliders): pieces per sprite,
+//        vertices per piece and the positions of all pieces
+//      - "num_layers" and "layers" are only written for texture arrays (--array)
+//      - "slices" (4 insets per sprite) is omitted if there are no nine-slice sprites
+//      - "transforms" is omitted if no sprite is a transformed duplicate (--dedupe)
+//      - "palettes" (colors of all palettes, addressed by "palette_sizes") and "sprite_palettes"
+//        are only written if there are indexed sprites (--palettes), -1 is an RGBA sprite
+static bool atlasc__save_json_compact(const atlasc_args_files* args, const atlasc_sprite* sprites,
+                                      int num_sprites, const atlasc_palette* palettes,
+                                      int num_palettes, const char* image_filename, int dst_w,
+                                      int dst_h, sx_mem_writer* out)
+{
+    sjson_context* jctx = sjson_create_context(0, 0, (void*)g_alloc);
+    if (!jctx) {
+        sx_assert(0);
+        return false;
+    }
+
+    sjson_node* jroot = sjson_mkobject(jctx);
+    sjson_put_int(jctx, jroot, "version", 2);
+    sjson_put_string(jctx, jroot, "image", image_filename);
+    sjson_put_int(jctx, jroot, "image_width", dst_w);
+    sjson_put_int(jctx, jroot, "image_height", dst_h);
+    sjson_put_int(jctx, jroot, "num_sprites", num_sprites);
+    if (args->common.array)
+        sjson_put_int(jctx, jroot, "num_layers", atlasc__num_layers(sprites, num_sprites));
+
+    // names: shared string table + sequences
+    // each sequence is 6 ints: dir, prefix, ext (string indices), start, count, digits
+    // sprites are ordered by sequence, name = dir/prefix + zero-padded (start + frame) + ext
+    atlasc__name_table names;
+    if (!atlasc__name_table_build(&names, args->in_filepaths, num_sprites)) {
+        sjson_destroy_context(jctx);
+        return false;
+    }
+    sjson_put_strings(jctx, jroot, "strings", (const char**)names.strs,
+                      sx_array_count(names.strs));
+    sjson_node* jseqs = sjson_put_array(jctx, jroot, "sequences");
+    for (int i = 0, c = sx_array_count(names.seqs); i < c; i++) {
+        const atlasc__name_seq* seq = &names.seqs[i];
+        const int fields[] = { seq->dir,   seq->prefix, seq->ext,
+                               seq->start, seq->count,  seq->digits };
+        for (int k = 0; k < 6; k++)
+            sjson_append_element(jseqs, sjson_mknumber(jctx, (double)fields[k]));
+    }
+    atlasc__name_table_release(&names);
+
+    bool trimmed = false;
+    bool has_mesh = false;
+    bool has_colliders = false;
+    bool has_slice = false;
+    bool has_transform = false;
+    sjson_node* jsizes = sjson_put_array(jctx, jroot, "sizes");
+    for (int i = 0; i < num_sprites; i++) {
+        const atlasc_sprite* spr = &sprites[i];
+        sjson_append_element(jsizes, sjson_mknumber(jctx, (double)spr->src_size.x));
+        sjson_append_element(jsizes, sjson_mknumber(jctx, (double)spr->src_size.y));
+
+        trimmed |= spr->sprite_rect.xmin != 0 || spr->sprite_rect.ymin != 0 ||
+                   spr->sprite_rect.xmax != spr->src_size.x ||
+                   spr->sprite_rect.ymax != spr->src_size.y;
+        has_mesh |= spr->num_tris > 0;
+        has_colliders |= spr->num_colliders > 0;
+        has_slice |= atlasc__has_slice(spr->slice);
+        has_transform |= spr->transform != 0;
+    }
+
+    if (trimmed) {
+        sjson_node* jrects = sjson_put_array(jctx, jroot, "sprite_rects");
+        for (int i = 0; i < num_sprites; i++) {
+            const sx_irect rc = sprites[i].sprite_rect;
+            for (int k = 0; k < 4; k++)
+                sjson_append_element(jrects, sjson_mknumber(jctx, (double)rc.f[k]));
+        }
+    }
+
+    sjson_node* jsheet_rects = sjson_put_array(jctx, jroot, "sheet_rects");
+    for (int i = 0; i < num_sprites; i++) {
+        const sx_irect rc = sprites[i].sheet_rect;
+        for (int k = 0; k < 4; k++)
+            sjson_append_element(jsheet_rects, sjson_mknumber(jctx, (double)rc.f[k]));
+    }
+
+    if (args->common.array) {
+        sjson_node* jlayers = sjson_put_array(jctx, jroot, "layers");
+        for (int i = 0; i < num_sprites; i++)
+            sjson_append_element(jlayers, sjson_mknumber(jctx, (double)sprites[i].layer));
+    }
+
+    if (has_slice) {
+        sjson_node* jslices = sjson_put_array(jctx, jroot, "slices");
+        for (int i = 0; i < num_sprites; i++) {
+            for (int k = 0; k < 4; k++)
+                sjson_append_element(jslices, sjson_mknumber(jctx, (double)sprites[i].slice[k]));
+        }
+    }
+
+    if (num_palettes > 0) {
+        sjson_node* jsizes = sjson_put_array(jctx, jroot, "palette_sizes");
+        sjson_node* jcolors = sjson_put_array(jctx, jroot, "palettes");
+        for (int i = 0; i < num_palettes; i++) {
+            sjson_append_element(jsizes, sjson_mknumber(jctx, (double)palettes[i].num_colors));
+            for (int k = 0; k < palettes[i].num_colors; k++)
+                sjson_append_element(jcolors, sjson_mknumber(jctx, (double)palettes[i].colors[k]));
+        }
+        sjson_node* jsprite_pals = sjson_put_array(jctx, jroot, "sprite_palettes");
+        for (int i = 0; i < num_sprites; i++)
+            sjson_append_element(jsprite_pals, sjson_mknumber(jctx, (double)sprites[i].palette));
+    }
+
+    if (has_transform) {
+        sjson_node* jtransforms = sjson_put_array(jctx, jroot, "transforms");
+        for (int i = 0; i < num_sprites; i++)
+            sjson_append_element(jtransforms, sjson_mknumber(jctx, (double)sprites[i].transform));
+    }
+
+    if (has_mesh) {
+        sjson_node* jmeshes = sjson_put_obj(jctx, jroot, "meshes");
+        sjson_node* jnum_tris = sjson_put_array(jctx, jmeshes, "num_tris");
+        sjson_node* jnum_verts = sjson_put_array(jctx, jmeshes, "num_vertices");
+        sjson_node* jindices = sjson_put_array(jctx, jmeshes, "indices");
+        sjson_node* jposs = sjson_put_array(jctx, jmeshes, "positions");
+        sjson_node* juvs = sjson_put_array(jctx, jmeshes, "uvs");
+        for (int i = 0; i < num_sprites; i++) {
+            const atlasc_sprite* spr = &sprites[i];
+            sjson_append_element(jnum_tris, sjson_mknumber(jctx, (double)spr->num_tris));
+            sjson_append_element(jnum_verts, sjson_mknumber(jctx, (double)spr->num_points));
+
+            for (int k = 0, c = (int)spr->num_tris * 3; k < c; k++)
+                sjson_append_element(jindices, sjson_mknumber(jctx, (double)spr->tris[k]));
+            for (int v = 0; v < spr->num_points; v++) {
+                sx_ivec2 pt = atlasc__sprite_pt(spr, v);
+                sx_ivec2 uv = atlasc__sprite_uv(spr, v, args->common.padding);
+                sjson_append_element(jposs, sjson_mknumber(jctx, (double)pt.x));
+                sjson_append_element(jposs, sjson_mknumber(jctx, (double)pt.y));
+                sjson_append_element(juvs, sjson_mknumber(jctx, (double)uv.x));
+                sjson_append_element(juvs, sjson_mknumber(jctx, (double)uv.y));
+            }
+        }
+    }
+
+    if (has_colliders) {
+        sjson_node* jcolliders = sjson_put_obj(jctx, jroot, "colliders");
+        sjson_node* jnum_pieces = sjson_put_array(jctx, jcolliders, "num_pieces");
+        sjson_node* jnum_verts = sjson_put_array(jctx, jcolliders, "num_vertices");
+        sjson_node* jposs = sjson_put_array(jctx, jcolliders, "positions");
+        for (int i = 0; i < num_sprites; i++) {
+            const atlasc_sprite* spr = &sprites[i];
+            sjson_append_element(jnum_pieces, sjson_mknumber(jctx, (double)spr->num_colliders));
+            for (int c = 0; c < spr->num_colliders; c++) {
+                sjson_append_element(jnum_verts,
+                                     sjson_mknumber(jctx, (double)spr->collider_sizes[c]));
+            }
+            for (int v = 0; v < spr->num_collider_pts; v++) {
+                sx_ivec2 pt = spr->collider_pts[v];
+                sjson_append_element(jposs, sjson_mknumber(jctx, (double)pt.x));
+                sjson_append_element(jposs, sjson_mknumber(jctx, (double)pt.y));
+            }
+        }
+    }
+
+    return atlasc__write_json(jctx, jroot, out);
+}
+
+static void atlasc__write_varint(sx_mem_writer* writer, uint32_t v)
+{
+    uint8_t buff[5];
+    int n = 0;
+    do {
+        buff[n] = (uint8_t)(v & 0x7f);
+        v >>= 7;
+        buff[n++] |= v ? 0x80 : 0;
+    } while (v);
+    sx_mem_write(writer, buff, n);
+}
+
+// fields of the binary descriptor are 16bit, positions are relative to sprite_rect (int16)
+static bool atlasc__bin_check_range(const atlasc_sprite* sprites, int num_sprites, int dst_w,
+                                    int dst_h)
+{
+    if (dst_w > UINT16_MAX || dst_h > UINT16_MAX) {
+        sx_snprintf(g_error_str, sizeof(g_error_str),
+                    "atlas is too large for binary descriptor: %dx%d", dst_w, dst_h);
+        return false;
+    }
+    for (int i = 0; i < num_sprites; i++) {
+        const atlasc_sprite* spr = &sprites[i];
+        if (spr->src_size.x > INT16_MAX || spr->src_size.y > INT16_MAX ||
+            spr->layer > UINT16_MAX || spr->palette >= ATLASC_BIN_NO_PALETTE ||
+            spr->num_points >= UINT16_MAX || spr->num_colliders > UINT16_MAX ||
+            spr->num_collider_pts > UINT16_MAX) {
+            sx_snprintf(g_error_str, sizeof(g_error_str),
+                        "sprite is too large for binary descriptor: #%d", i + 1);
+            return false;
+        }
+    }
+    return true;
+}
+
+// binary descriptor, see atlasc-reader.h for the layout
+static bool atlasc__save_bin(const atlasc_args_files* args, const atlasc_sprite* sprites,
+                             int num_sprites, const atlasc_palette* palettes, int num_palettes,
+                             const char* image_filename, int dst_w, int dst_h, sx_mem_writer* out)
+{
+    if (!atlasc__bin_check_range(sprites, num_sprites, dst_w, dst_h))
+        return false;
+
+    bool r = false;
+    sx_mem_writer strings;
+    sx_mem_writer meshes;
+    sx_mem_writer hit_masks;
+    sx_mem_writer colliders;
+    sx_mem_init_writer(&strings, g_alloc, 0);
+    sx_mem_init_writer(&meshes, g_alloc, 0);
+    sx_mem_init_writer(&hit_masks, g_alloc, 0);
+    sx_mem_init_writer(&colliders, g_alloc, 0);
+
+    atlasc__name_table names;
+    uint32_t* str_offsets = NULL;
+    atlasc_bin_sequence* bseqs = NULL;
+    atlasc_bin_sprite* bsprites =
+        atlasc__malloc(sizeof(atlasc_bin_sprite) * num_sprites, g_alloc_ctx);
+    if (!bsprites) {
+        sx_out_of_memory();
+        sx_memset(&names, 0x0, sizeof(names));
+        goto cleanup;
+    }
+    sx_memset(bsprites, 0x0, sizeof(atlasc_bin_sprite) * num_sprites);
+
+    if (!atlasc__name_table_build(&names, args->in_filepaths, num_sprites))
+        goto cleanup;
+
+    uint32_t flags = 0;
+    sx_mem_write(&strings, image_filename, sx_strlen(image_filename) + 1);
+
+    int num_strs = sx_array_count(names.strs);
+    str_offsets = atlasc__malloc(sizeof(uint32_t) * num_strs, g_alloc_ctx);
+    int num_seqs = sx_array_count(names.seqs);
+    bseqs = atlasc__malloc(sizeof(atlasc_bin_sequence) * num_seqs, g_alloc_ctx);
+    if (!str_offsets || !bseqs) {
+        sx_out_of_memory();
+        goto cleanup;
+    }
+    for (int i = 0; i < num_strs; i++) {
+        str_offsets[i] = (uint32_t)strings.pos;
+        sx_mem_write(&strings, names.strs[i], sx_strlen(names.strs[i]) + 1);
+    }
+    for (int i = 0; i < num_seqs; i++) {
+        const atlasc__name_seq* seq = &names.seqs[i];
+        bseqs[i] = (atlasc_bin_sequence){ .dir = str_offsets[seq->dir],
+                                          .prefix = str_offsets[seq->prefix],
+                                          .ext = str_offsets[seq->ext],
+                                          .start = (uint32_t)seq->start,
+                                          .count = (uint32_t)seq->count,
+                                          .digits = (uint32_t)seq->digits,
+                                          .first_sprite = (uint32_t)seq->first_sprite };
+    }
+
+    for (int i = 0; i < num_sprites; i++) {
+        const atlasc_sprite* spr = &sprites[i];
+        atlasc_bin_sprite* bspr = &bsprites[i];
+
+        bspr->sequence = (uint32_t)names.sprite_seqs[i];
+
+        bspr->src_size[0] = (uint16_t)spr->src_size.x;
+        bspr->src_size[1] = (uint16_t)spr->src_size.y;
+        for (int k = 0; k < 4; k++) {
+            bspr->sprite_rect[k] = (uint16_t)spr->sprite_rect.f[k];
+            bspr->sheet_rect[k] = (uint16_t)spr->sheet_rect.f[k];
+        }
+        bspr->layer = (uint16_t)spr->layer;
+        bspr->transform = (uint16_t)spr->transform;
+        bspr->palette = spr->palette >= 0 ? (uint16_t)spr->palette : ATLASC_BIN_NO_PALETTE;
+        if (atlasc__has_slice(spr->slice)) {
+            flags |= ATLASC_BIN_FLAG_SLICE;
+            for (int k = 0; k < 4; k++)
+                bspr->slice[k] = (uint16_t)spr->slice[k];
+        }
+
+        if (spr->num_tris) {
+            flags |= ATLASC_BIN_FLAG_MESH;
+            bspr->mesh = (uint32_t)meshes.pos;
+            bspr->num_points = (uint16_t)spr->num_points;
+            bspr->num_tris = spr->num_tris;
+
+            for (int v = 0; v < spr->num_points; v++) {
+                sx_ivec2 pt = sx_ivec2_sub(atlasc__sprite_pt(spr, v), spr->sprite_rect.vmin);
+                int16_t qpt[2] = { (int16_t)pt.x, (int16_t)pt.y };
+                sx_mem_write(&meshes, qpt, sizeof(qpt));
+            }
+
+            int prev = 0;
+            for (int k = 0, c = (int)spr->num_tris * 3; k < c; k++) {
+                int delta = (int)spr->tris[k] - prev;
+                atlasc__write_varint(&meshes, (uint32_t)((delta << 1) ^ (delta >> 31)));
+                prev = spr->tris[k];
+            }
+        }
+
+        if (spr->hit_mask) {
+            int cell = args->common.hit_mask;
+            int w = spr->sprite_rect.xmax - spr->sprite_rect.xmin;
+            int h = spr->sprite_rect.ymax - spr->sprite_rect.ymin;
+            int pitch = ((w + cell - 1) / cell + 7) >> 3;
+            flags |= ATLASC_BIN_FLAG_HIT_MASK;
+            bspr->hit_mask = (uint32_t)hit_masks.pos;
+            sx_mem_write(&hit_masks, spr->hit_mask, pitch * ((h + cell - 1) / cell));
+        }
+
+        if (spr->num_colliders) {
+            flags |= ATLASC_BIN_FLAG_COLLIDERS;
+            bspr->colliders = (uint32_t)colliders.pos;
+            bspr->num_colliders = (uint16_t)spr->num_colliders;
+            bspr->num_collider_pts = (uint16_t)spr->num_collider_pts;
+            sx_mem_write(&colliders, spr->collider_sizes, spr->num_colliders);
+            for (int v = 0; v < spr->num_collider_pts; v++) {
+                sx_ivec2 pt = sx_ivec2_sub(spr->collider_pts[v], spr->sprite_rect.vmin);
+                int16_t qpt[2] = { (int16_t)pt.x, (int16_t)pt.y };
+                sx_mem_write(&colliders, qpt, sizeof(qpt));
+            }
+        }
+    }
+
+    atlasc_bin_header hdr = { .magic = ATLASC_BIN_MAGIC,
+                              .version = ATLASC_BIN_VERSION,
+                              .flags = flags,
+                              .image_width = (uint16_t)dst_w,
+                              .image_height = (uint16_t)dst_h,
+                              .padding = (uint16_t)args->common.padding,
+                              .num_layers = (uint16_t)atlasc__num_layers(sprites, num_sprites),
+                              .num_sprites = (uint32_t)num_sprites,
+                              .num_sequences = (uint32_t)num_seqs,
+                              .image_name = 0 };
+    hdr.sprites_offset = sizeof(hdr);
+    hdr.sequences_offset = hdr.sprites_offset + sizeof(atlasc_bin_sprite) * num_sprites;
+    hdr.strings_offset = hdr.sequences_offset + sizeof(atlasc_bin_sequence) * num_seqs;
+    hdr.strings_size = (uint32_t)strings.pos;
+    hdr.meshes_offset = hdr.strings_offset + hdr.strings_size;
+    hdr.meshes_size = (uint32_t)meshes.pos;
+    hdr.num_palettes = (uint32_t)num_palettes;
+    hdr.palettes_offset = hdr.meshes_offset + hdr.meshes_size;
+    for (int i = 0; i < num_palettes; i++)
+        hdr.num_palette_colors += (uint32_t)palettes[i].num_colors;
+    hdr.hit_mask_cell = (uint32_t)args->common.hit_mask;
+    hdr.hit_masks_offset = hdr.palettes_offset +
+                           (uint32_t)sizeof(atlasc_bin_palette) * hdr.num_palettes +
+                           (uint32_t)sizeof(uint32_t) * hdr.num_palette_colors;
+    hdr.hit_masks_size = (uint32_t)hit_masks.pos;
+    hdr.colliders_offset = hdr.hit_masks_offset + hdr.hit_masks_size;
+    hdr.colliders_size = (uint32_t)colliders.pos;
+
+    sx_mem_write_var(out, hdr);
+    sx_mem_write(out, bsprites, (int)sizeof(atlasc_bin_sprite) * num_sprites);
+    sx_mem_write(out, bseqs, (int)sizeof(atlasc_bin_sequence) * num_seqs);
+    sx_mem_write(out, strings.data, (int)strings.pos);
+    sx_mem_write(out, meshes.data, (int)meshes.pos);
+    for (int i = 0, first = 0; i < num_palettes; i++) {
+        atlasc_bin_palette bpal = { .first_color = (uint32_t)first,
+                                    .num_colors = (uint32_t)palettes[i].num_colors };
+        sx_mem_write_var(out, bpal);
+        first += palettes[i].num_colors;
+    }
+    for (int i = 0; i < num_palettes; i++)
+        sx_mem_write(out, palettes[i].colors, palettes[i].num_colors * (int)sizeof(uint32_t));
+    sx_mem_write(out, hit_masks.data, (int)hit_masks.pos);
+    sx_mem_write(out, colliders.data, (int)colliders.pos);
+    r = true;
+
+cleanup:
+    atlasc__free(bsprites, g_alloc_ctx);
+    atlasc__free(bseqs, g_alloc_ctx);
+    atlasc__free(str_offsets, g_alloc_ctx);
+    atlasc__name_table_release(&names);
+    sx_mem_release_writer(&strings);
+    sx_mem_release_writer(&meshes);
+    sx_mem_release_writer(&hit_masks);
+    sx_mem_release_writer(&colliders);
+    return r;
+}
+
+#define ATLASC__QOI_MAGIC 0x66696f71    // 'qoif'
+#define ATLASC__DDS_MAGIC 0x20534444    // 'DDS '
+#define ATLASC__DDS_DX10 0x30315844     // 'DX10'
+
+typedef struct atlasc__read_buffer {
+    uint8_t* data;
+    int capacity;
+} atlasc__read_buffer;
+
+// patches load the previous image with the input readers (see below)
+static uint8_t* atlasc__load_image(const char* filepath, int* width, int* height,
+                                   atlasc__read_buffer* buff);
+
+#define ATLASC__PATCH_TILE_SIZE 32
+#define ATLASC__DELTA_HASH_BITS 16
+#define ATLASC__DELTA_MIN_COPY 16
+
+static void atlasc__delta_write_insert(sx_mem_writer* writer, const uint8_t* data, int len)
+{
+    if (len > 0) {
+        atlasc__write_varint(writer, (uint32_t)len << 1);
+        sx_mem_write(writer, data, len);
+    }
+}
+
+// encodes `cur` as copy/insert operations against `prev` (see atlasc-reader.h)
+// it's basically LZ77 with the previous descriptor as the dictionary
+static bool atlasc__delta_encode(const uint8_t* prev, int prev_size, const uint8_t* cur,
+                                 int size, sx_mem_writer* writer)
+{
+    int* table = atlasc__malloc(sizeof(int) << ATLASC__DELTA_HASH_BITS, g_alloc_ctx);
+    if (!table) {
+        sx_out_of_memory();
+        return false;
+    }
+    sx_memset(table, 0xff, sizeof(int) << ATLASC__DELTA_HASH_BITS);
+
+    for (int i = 0; i + 4 <= prev_size; i++) {
+        uint32_t h = (atlasc__lz_read32(prev + i) * 2654435761u) >> (32 - ATLASC__DELTA_HASH_BITS);
+        table[h] = i;
+    }
+
+    int ip = 0;
+    int anchor = 0;
+    while (ip + 4 <= size) {
+        uint32_t seq = atlasc__lz_read32(cur + ip);
+        int ref = table[(seq * 2654435761u) >> (32 - ATLASC__DELTA_HASH_BITS)];
+        if (ref >= 0 && atlasc__lz_read32(prev + ref) == seq) {
+            int start = ip;
+            while (start > anchor && ref > 0 && cur[start - 1] == prev[ref - 1]) {
+                start--;
+                ref--;
+            }
+            int len = ip - start;
+            while (start + len < size && ref + len < prev_size &&
+                   cur[start + len] == prev[ref + len]) {
+                len++;
+            }
+
+            if (len >= ATLASC__DELTA_MIN_COPY) {
+                atlasc__delta_write_insert(writer, cur + anchor, start - anchor);
+                atlasc__write_varint(writer, ((uint32_t)len << 1) | 1);
+                atlasc__write_varint(writer, (uint32_t)ref);
+                ip = anchor = start + len;
+                continue;
+            }
+        }
+        ip++;
+    }
+    atlasc__delta_write_insert(writer, cur + anchor, size - anchor);
+
+    atlasc__free(table, g_alloc_ctx);
+    return true;
+}
+
+// outputs of the previous build that the patch is made against. they are loaded before the new
+// outputs are written, which may overwrite them (in-place rebuilds)
+typedef struct atlasc__patch_prev {
+    sx_mem_block* desc;    // uncompressed descriptor
+    uint8_t* pixels;
+    int w;
+    int h;
+} atlasc__patch_prev;
+
+static void atlasc__patch_prev_release(atlasc__patch_prev* prev)
+{
+    if (prev->desc)
+        sx_mem_destroy_block(prev->desc);
+    if (prev->pixels)
+        stbi_image_free(prev->pixels);
+    sx_memset(prev, 0x0, sizeof(*prev));
+}
+
+// prev_filepath: previous descriptor file, the image is next to it with the same name
+static bool atlasc__patch_prev_load(atlasc__patch_prev* prev, const char* prev_filepath,
+                                    const char* image_ext)
+{
+    char file_ext[32];
+    char prev_image_filepath[256];
+    sx_os_path_splitext(file_ext, sizeof(file_ext), prev_image_filepath,
+                        sizeof(prev_image_filepath), prev_filepath);
+    sx_strcat(prev_image_filepath, sizeof(prev_image_filepath), image_ext);
+    sx_memset(prev, 0x0, sizeof(*prev));
+
+    sx_mem_block* prev_desc = sx_file_load_bin(g_alloc, prev_filepath);
+    if (!prev_desc) {
+        sx_snprintf(g_error_str, sizeof(g_error_str), "could not open previous descriptor: %s",
+                    prev_filepath);
+        return false;
+    }
+
+    // descriptor deltas are made against uncompressed data
+    uint32_t prev_size = atlasc_lz_size(prev_desc->data, (uint32_t)prev_desc->size);
+    if (prev_size) {
+        sx_mem_block* block = sx_mem_create_block(g_alloc, (int)prev_size, NULL, 0);
+        if (!block || !atlasc_lz_decompress(prev_desc->data, (uint32_t)prev_desc->size,
+                                            block->data, prev_size)) {
+            sx_snprintf(g_error_str, sizeof(g_error_str), "invalid previous descriptor: %s",
+                        prev_filepath);
+            sx_mem_destroy_block(prev_desc);
+            if (block)
+                sx_mem_destroy_block(block);
+            return false;
+        }
+        sx_mem_destroy_block(prev_desc);
+        prev_desc = block;
+    }
+
+    atlasc__read_buffer read_buff = { 0 };
+    prev->pixels = atlasc__load_image(prev_image_filepath, &prev->w, &prev->h, &read_buff);
+    atlasc__free(read_buff.data, g_alloc_ctx);
+    if (!prev->pixels) {
+        sx_snprintf(g_error_str, sizeof(g_error_str), "could not open previous image: %s",
+                    prev_image_filepath);
+        sx_mem_destroy_block(prev_desc);
+        return false;
+    }
+    prev->desc = prev_desc;
+    return true;
+}
+
+// writes a patch that updates the previous build to the current outputs. tiles of the image that
+// are changed are stored as raw pixels, the descriptor is delta encoded against the previous one
+static bool atlasc__save_patch(const char* filepath, const atlasc__patch_prev* prev,
+                               const void* desc, int desc_size, const uint8_t* pixels, int w,
+                               int h)
+{
+    const uint8_t* prev_pixels = prev->pixels;
+    int pw = prev->w, ph = prev->h;
+
+    // image sizes of the patch header are 16bit, layers of arrays are stacked vertically
+    if (w > UINT16_MAX || h > UINT16_MAX || pw > UINT16_MAX || ph > UINT16_MAX) {
+        sx_snprintf(g_error_str, sizeof(g_error_str),
+                    "atlas is too large for patch: %dx%d (previous %dx%d)", w, h, pw, ph);
+        return false;
+    }
+
+    // find changed tiles, pixels out of the previous image's bounds are counted as zero
+    const int ts = ATLASC__PATCH_TILE_SIZE;
+    sx_mem_writer tiles;
+    sx_mem_writer tile_pixels;
+    sx_mem_writer ops;
+    sx_mem_init_writer(&tiles, g_alloc, 0);
+    sx_mem_init_writer(&tile_pixels, g_alloc, 0);
+    sx_mem_init_writer(&ops, g_alloc, 0);
+    uint32_t num_tiles = 0;
+    for (int ty = 0; ty * ts < h; ty++) {
+        for (int tx = 0; tx * ts < w; tx++) {
+            int x0 = tx * ts, y0 = ty * ts;
+            int tw = sx_min(ts, w - x0), th = sx_min(ts, h - y0);
+            bool changed = false;
+            for (int y = y0; y < y0 + th && !changed; y++) {
+                const uint8_t* row = pixels + ((size_t)y * w + x0) * 4;
+                for (int x = x0; x < x0 + tw && !changed; x++, row += 4) {
+                    uint32_t prev_px = 0, px;
+                    if (x < pw && y < ph)
+                        sx_memcpy(&prev_px, prev_pixels + ((size_t)y * pw + x) * 4, 4);
+                    sx_memcpy(&px, row, 4);
+                    changed = px != prev_px;
+                }
+            }
+
+            if (changed) {
+                uint16_t coords[2] = { (uint16_t)tx, (uint16_t)ty };
+                sx_mem_write(&tiles, coords, sizeof(coords));
+                for (int y = y0; y < y0 + th; y++)
+                    sx_mem_write(&tile_pixels, pixels + ((size_t)y * w + x0) * 4, tw * 4);
+                num_tiles++;
+            }
+        }
+    }
+
+    bool r = atlasc__delta_encode(prev->desc->data, prev->desc->size, desc, desc_size, &ops);
+    if (r && (int64_t)sizeof(atlasc_patch_header) + tiles.pos + tile_pixels.pos + ops.pos >
+                 INT32_MAX) {
+        sx_snprintf(g_error_str, sizeof(g_error_str), "patch is too large: %s", filepath);
+        r = false;
+    }
+    if (r) {
+        atlasc_patch_header hdr = { .magic = ATLASC_PATCH_MAGIC,
+                                    .version = ATLASC_PATCH_VERSION,
+                                    .image_width = (uint16_t)w,
+                                    .image_height = (uint16_t)h,
+                                    .prev_width = (uint16_t)pw,
+                                    .prev_height = (uint16_t)ph,
+                                    .tile_size = (uint16_t)ts,
+                                    .num_tiles = num_tiles,
+                                    .desc_size = (uint32_t)desc_size };
+        hdr.tiles_offset = sizeof(hdr);
+        hdr.pixels_offset = hdr.tiles_offset + (uint32_t)tiles.pos;
+        hdr.pixels_size = (uint32_t)tile_pixels.pos;
+        hdr.desc_ops_offset = hdr.pixels_offset + hdr.pixels_size;
+        hdr.desc_ops_size = (uint32_t)ops.pos;
+
+        sx_mem_writer patch;
+        sx_mem_init_writer(&patch, g_alloc, (int)(hdr.desc_ops_offset + hdr.desc_ops_size));
+        sx_mem_write_var(&patch, hdr);
+        sx_mem_write(&patch, tiles.data, (int)tiles.pos);
+        sx_mem_write(&patch, tile_pixels.data, (int)tile_pixels.pos);
+        sx_mem_write(&patch, ops.data, (int)ops.pos);
+        r = atlasc__write_desc(filepath, patch.data, (int)patch.pos, true);
+        sx_mem_release_writer(&patch);
+    }
+
+    sx_mem_release_writer(&tiles);
+    sx_mem_release_writer(&tile_pixels);
+    sx_mem_release_writer(&ops);
+    return r;
+}
+
+// cgroup v2 controller file of this process, like "cpu.max". false if there is none (not linux,
+// cgroup v1 or no controller)
+static bool atlasc__read_cgroup(const char* name, char* value, int size)
+{
+#if SX_PLATFORM_LINUX
+    char line[256];
+    char filepath[512];
+    const char* group = "";
+    FILE* f = fopen("/proc/self/cgroup", "r");
+    if (f) {
+        while (fgets(line, sizeof(line), f)) {
+            if (sx_strnequal(line, "0::", 3)) {
+                int len = sx_strlen(line);
+                if (line[len - 1] == '\n')
+                    line[len - 1] = '\0';
+                group = line + 3;
+                break;
+            }
+        }
+        fclose(f);
+    }
+
+    // the group is the root inside containers with a private cgroup namespace
+    sx_snprintf(filepath, sizeof(filepath), "/sys/fs/cgroup%s/%s",
+                sx_strequal(group, "/") ? "" : group, name);
+    f = fopen(filepath, "r");
+    if (!f)
+        return false;
+    bool r = fgets(value, size, f) != NULL;
+    fclose(f);
+    return r;
+#else
+    sx_unused(name);
+    sx_unused(value);
+    sx_unused(size);
+    return false;
+#endif
+}
+
+// cores, limited by the cgroup cpu quota
+static int atlasc__num_cores(void)
+{
+    static int num_cores = 0;
+    if (num_cores == 0) {
+        int n = sx_max(sx_os_numcores(), 1);
+        char value[64];
+        long long quota, period;
+        if (atlasc__read_cgroup("cpu.max", value, sizeof(value)) &&
+            sscanf(value, "%lld %lld", &quota, &period) == 2 && quota > 0 && period > 0) {
+            n = sx_clamp((int)((quota + period - 1) / period), 1, n);
+        }
+        num_cores = n;
+    }
+    return num_cores;
+}
+
+// memory left under the cgroup limit, 0 if not limited
+static int64_t atlasc__cgroup_memory(void)
+{
+    char value[64];
+    long long limit, usage;
+    if (!atlasc__read_cgroup("memory.max", value, sizeof(value)) ||
+        sscanf(value, "%lld", &limit) != 1) {
+        return 0;    // "max"
+    }
+    if (!atlasc__read_cgroup("memory.current", value, sizeof(value)) ||
+        sscanf(value, "%lld", &usage) != 1) {
+        usage = 0;
+    }
+    return sx_max((int64_t)(limit - usage), (int64_t)1);
+}
+
+// host job system (atlasc_set_job_callbacks), the built-in sx job pool is used if not set
+static atlasc_dispatch_cb* g_dispatch_fn;
+static atlasc_wait_cb* g_wait_fn;
+static int g_num_host_workers;
+static void* g_job_ctx;
+
+typedef struct atlasc__parallel_work {
+    sx_job_cb* fn;
+    void* user;
+    int count;
+    sx_atomic_int next;
+} atlasc__parallel_work;
+
+static void atlasc__parallel_worker(int index, void* user)
+{
+    sx_unused(index);
+    atlasc__parallel_work* work = user;
+    for (int i = sx_atomic_fetch_add(&work->next, 1); i < work->count;
+         i = sx_atomic_fetch_add(&work->next, 1)) {
+        work->fn(i, work->user);
+    }
+}
+
+// calls `fn` for indices [0, count) on all cores and waits for them to finish
+static bool atlasc__parallel_for(sx_job_cb* fn, void* user, int count)
+{
+    if (count <= 0)
+        return true;
+
+    if (g_dispatch_fn) {
+        atlasc__parallel_work work = { .fn = fn, .user = user, .count = count };
+        void* handle = g_dispatch_fn(atlasc__parallel_worker, &work,
+                                     sx_min(count, g_num_host_workers), g_job_ctx);
+        g_wait_fn(handle, g_job_ctx);
+        return true;
+    }
+
+    int num_workers = sx_min(sx_min(count, atlasc__num_cores()), 64);
+    sx_job_context* ctx = sx_job_create_context(
+        g_alloc, &(sx_job_context_desc){ .num_threads = num_workers - 1,
+                                         .max_fibers = num_workers });
+    if (!ctx) {
+        sx_snprintf(g_error_str, sizeof(g_error_str), "could not create job context");
+        return false;
+    }
+
+    atlasc__parallel_work work = { .fn = fn, .user = user, .count = count };
+    sx_job_desc descs[64];
+    for (int i = 0; i < num_workers; i++)
+        descs[i] = (sx_job_desc){ .callback = atlasc__parallel_worker, .user = &work };
+    sx_job_wait_and_del(ctx, sx_job_dispatch(ctx, descs, num_workers, 0));
+    sx_job_destroy_context(ctx, g_alloc);
+    return true;
+}
+
+////////////////////////////////////////////////////////////////////////////////////////////////////
+// png optimizer (--optimize)
+// every filter strategy is deflated with dynamic huffman blocks and iterated optimal parsing (the
+// cost model of each pass comes from the symbol statistics of the previous one). filtered data is
+// cut into chunks that are compressed in parallel: a chunk can still match into the last 32k of
+// the previous one and ends with an empty stored block, so compressed chunks are byte aligned and
+// are simply concatenated. the smallest strategy is written
+#define ATLASC__DEFLATE_WINDOW 32768
+#define ATLASC__DEFLATE_MAX_MATCH 258
+#define ATLASC__DEFLATE_HASH_BITS 15
+#define ATLASC__DEFLATE_MAX_CHAIN 512
+#define ATLASC__DEFLATE_GOOD_MATCH 32     // chain is cut to a quarter after a match this long
+#define ATLASC__DEFLATE_NICE_MATCH 128    // search stops after a match this long
+#define ATLASC__DEFLATE_MAX_ENTRIES 8    // matches kept per position
+#define ATLASC__DEFLATE_ITERATIONS 6
+#define ATLASC__DEFLATE_CHUNK_SIZE (256 * 1024)
+#define ATLASC__DEFLATE_SPLIT_DEPTH 3
+#define ATLASC__DEFLATE_NUM_LITLENS 286
+#define ATLASC__DEFLATE_NUM_DISTS 30
+
+typedef enum atlasc__png_strategy {
+    ATLASC__PNG_STRATEGY_MINSUM = 0,    // per row: smallest sum of absolute residuals
+    ATLASC__PNG_STRATEGY_ENTROPY,       // per row: smallest residual byte entropy
+    ATLASC__PNG_STRATEGY_NONE,          // all rows unfiltered
+    ATLASC__PNG_STRATEGY_PAETH,         // all rows paeth
+    ATLASC__PNG_STRATEGY_COUNT
+} atlasc__png_strategy;
+
+typedef struct atlasc__deflate_sym {
+    uint16_t litlen;    // literal byte or match length
+    uint16_t dist;      // zero for literals
+} atlasc__deflate_sym;
+
+typedef struct atlasc__deflate_costs {
+    float lit[256];
+    float len[ATLASC__DEFLATE_MAX_MATCH + 1];    // including extra bits
+    float dist[ATLASC__DEFLATE_NUM_DISTS];       // including extra bits
+} atlasc__deflate_costs;
+
+typedef struct atlasc__bit_writer {
+    sx_mem_writer* writer;
+    uint64_t bits;
+    int count;
+} atlasc__bit_writer;
+
+typedef struct atlasc__png_job {
+    const uint8_t* pixels;
+    int width;
+    int height;
+    int data_size;
+    int num_chunks;
+    uint8_t* filtered[ATLASC__PNG_STRATEGY_COUNT];
+    sx_mem_writer* chunks;    // ATLASC__PNG_STRATEGY_COUNT * num_chunks
+    int skip[ATLASC__PNG_STRATEGY_COUNT];    // same output as another strategy, or out of memory
+} atlasc__png_job;
+
+static const uint16_t g_deflate_len_base[29] = { 3,  4,  5,  6,   7,   8,   9,   10,  11, 13,
+                                                 15, 17, 19, 23,  27,  31,  35,  43,  51, 59,
+                                                 67, 83, 99, 115, 131, 163, 195, 227, 258 };
+static const uint8_t g_deflate_len_extra[29] = { 0, 0, 0, 0, 0, 0, 0, 0, 1, 1, 1, 1, 2, 2, 2,
+                                                 2, 3, 3, 3, 3, 4, 4, 4, 4, 5, 5, 5, 5, 0 };
+static const uint16_t g_deflate_dist_base[30] = { 1,    2,    3,    4,    5,    7,     9,     13,
+                                                  17,   25,   33,   49,   65,   97,    129,   193,
+                                                  257,  385,  513,  769,  1025, 1537,  2049,  3073,
+                                                  4097, 6145, 8193, 12289, 16385, 24577 };
+static const uint8_t g_deflate_dist_extra[30] = { 0, 0, 0,  0,  1,  1,  2,  2,  3,  3,
+                                                  4, 4, 5,  5,  6,  6,  7,  7,  8,  8,
+                                                  9, 9, 10, 10, 11, 11, 12, 12, 13, 13 };
+static const uint8_t g_deflate_cl_order[19] = { 16, 17, 18, 0, 8,  7, 9,  6, 10, 5,
+                                                11, 4,  12, 3, 13, 2, 14, 1, 15 };
+static uint8_t g_deflate_len_sym[ATLASC__DEFLATE_MAX_MATCH + 1];
+
+static void atlasc__deflate_init(void)
+{
+    // later codes overwrite, so 258 gets its own symbol instead of the 227+31 one
+    for (int i = 0; i < 29; i++) {
+        int end = sx_min(g_deflate_len_base[i] + (1 << g_deflate_len_extra[i]),
+                         ATLASC__DEFLATE_MAX_MATCH + 1);
+        for (int l = g_deflate_len_base[i]; l < end; l++)
+            g_deflate_len_sym[l] = (uint8_t)i;
+    }
+}
+
+static inline int atlasc__deflate_dist_sym(int dist)
+{
+    int d = dist - 1;
+    if (d < 4)
+        return d;
+    int l = 2;
+    while ((d >> (l + 1)) != 0)
+        l++;
+    return 2 * l + ((d >> (l - 1)) & 1);
+}
+
+static void atlasc__bits_put(atlasc__bit_writer* bw, uint32_t value, int count)
+{
+    bw->bits |= (uint64_t)value << bw->count;
+    bw->count += count;
+    while (bw->count >= 8) {
+        uint8_t b = (uint8_t)bw->bits;
+        sx_mem_write(bw->writer, &b, 1);
+        bw->bits >>= 8;
+        bw->count -= 8;
+    }
+}
+
+static void atlasc__bits_align(atlasc__bit_writer* bw)
+{
+    if (bw->count > 0)
+        atlasc__bits_put(bw, 0, 8 - bw->count);
+}
+
+// length limited huffman code lengths, symbols with zero frequency get zero length
+static void atlasc__huff_lengths(const uint32_t* freqs, int num_syms, int max_bits,
+                                 uint8_t* lengths)
+{
+    int syms[ATLASC__DEFLATE_NUM_LITLENS];
+    uint32_t weights[2 * ATLASC__DEFLATE_NUM_LITLENS];
+    int parents[2 * ATLASC__DEFLATE_NUM_LITLENS];
+    int depths[2 * ATLASC__DEFLATE_NUM_LITLENS];
+    int num_used = 0;
+
+    sx_memset(lengths, 0x0, num_syms);
+    for (int i = 0; i < num_syms; i++) {
+        if (freqs[i])
+            syms[num_used++] = i;
+    }
+
+    // decoders want complete codes, pair lonely symbols with dummy ones
+    if (num_used < 2) {
+        lengths[0] = lengths[1] = 1;
+        if (num_used == 1 && syms[0] > 1)
+            lengths[syms[0]] = 1, lengths[1] = 0;
+        return;
+    }
+
+    for (int i = 1; i < num_used; i++) {
+        int s = syms[i];
+        int j = i;
+        for (; j > 0 && freqs[syms[j - 1]] > freqs[s]; j--)
+            syms[j] = syms[j - 1];
+        syms[j] = s;
+    }
+
+    // two-queue huffman: leaves are sorted, internal nodes are created in increasing weight
+    for (int i = 0; i < num_used; i++)
+        weights[i] = freqs[syms[i]];
+    int leaf = 0, node = num_used, num_nodes = num_used;
+    for (int k = 0; k < num_used - 1; k++) {
+        int pick[2];
+        for (int p = 0; p < 2; p++) {
+            if (leaf < num_used && (node == num_nodes || weights[leaf] <= weights[node]))
+                pick[p] = leaf++;
+            else
+                pick[p] = node++;
+        }
+        weights[num_nodes] = weights[pick[0]] + weights[pick[1]];
+        parents[pick[0]] = parents[pick[1]] = num_nodes;
+        num_nodes++;
+    }
+    depths[num_nodes - 1] = 0;
+    for (int i = num_nodes - 2; i >= 0; i--)
+        depths[i] = depths[parents[i]] + 1;
+
+    // clamp to max_bits and fix up the kraft sum (miniz does the same)
+    int counts[16] = { 0 };
+    for (int i = 0; i < num_used; i++)
+        counts[sx_min(depths[i], max_bits)]++;
+    uint32_t total = 0;
+    for (int i = max_bits; i > 0; i--)
+        total += (uint32_t)counts[i] << (max_bits - i);
+    while (total > (1u << max_bits)) {
+        counts[max_bits]--;
+        for (int i = max_bits - 1; i > 0; i--) {
+            if (counts[i]) {
+                counts[i]--;
+                counts[i + 1] += 2;
+                break;
+            }
+        }
+        total--;
+    }
+
+    // least frequent symbols get the longest codes
+    int s = 0;
+    for (int len = max_bits; len > 0; len--) {
+        for (int c = 0; c < counts[len]; c++)
+            lengths[syms[s++]] = (uint8_t)len;
+    }
+}
+
+// canonical codes, bit reversed for the lsb-first deflate bit stream
+static void atlasc__huff_codes(const uint8_t* lengths, int num_syms, uint16_t* codes)
+{
+    int counts[16] = { 0 };
+    uint32_t next[16];
+    for (int i = 0; i < num_syms; i++)
+        counts[lengths[i]]++;
+    counts[0] = 0;
+    uint32_t code = 0;
+    for (int b = 1; b < 16; b++) {
+        code = (code + counts[b - 1]) << 1;
+        next[b] = code;
+    }
+    for (int i = 0; i < num_syms; i++) {
+        int len = lengths[i];
+        uint32_t c = len ? next[len]++ : 0;
+        uint32_t r = 0;
+        for (int k = 0; k < len; k++, c >>= 1)
+            r = (r << 1) | (c & 1);
+        codes[i] = (uint16_t)r;
+    }
+}
+
+static void atlasc__deflate_freqs(const atlasc__deflate_sym* syms, int num_syms,
+                                  uint32_t* lit_freqs, uint32_t* dist_freqs)
+{
+    sx_memset(lit_freqs, 0x0, sizeof(uint32_t) * ATLASC__DEFLATE_NUM_LITLENS);
+    sx_memset(dist_freqs, 0x0, sizeof(uint32_t) * ATLASC__DEFLATE_NUM_DISTS);
+    for (int i = 0; i < num_syms; i++) {
+        if (syms[i].dist == 0) {
+            lit_freqs[syms[i].litlen]++;
+        } else {
+            lit_freqs[257 + g_deflate_len_sym[syms[i].litlen]]++;
+            dist_freqs[atlasc__deflate_dist_sym(syms[i].dist)]++;
+        }
+    }
+    lit_freqs[256] = 1;
+}
+
+// writes `syms` as a single dynamic huffman block, only measures it if `bw` is NULL. returns bits
+static uint32_t atlasc__deflate_block(atlasc__bit_writer* bw, const atlasc__deflate_sym* syms,
+                                      int num_syms, bool final)
+{
+    uint32_t lit_freqs[ATLASC__DEFLATE_NUM_LITLENS];
+    uint32_t dist_freqs[ATLASC__DEFLATE_NUM_DISTS];
+    uint8_t lengths[ATLASC__DEFLATE_NUM_LITLENS + ATLASC__DEFLATE_NUM_DISTS];
+    uint8_t* dist_lengths = lengths + ATLASC__DEFLATE_NUM_LITLENS;
+
+    atlasc__deflate_freqs(syms, num_syms, lit_freqs, dist_freqs);
+    atlasc__huff_lengths(lit_freqs, ATLASC__DEFLATE_NUM_LITLENS, 15, lengths);
+    atlasc__huff_lengths(dist_freqs, ATLASC__DEFLATE_NUM_DISTS, 15, dist_lengths);
+
+    int hlit = ATLASC__DEFLATE_NUM_LITLENS;
+    while (hlit > 257 && lengths[hlit - 1] == 0)
+        hlit--;
+    int hdist = ATLASC__DEFLATE_NUM_DISTS;
+    while (hdist > 1 && dist_lengths[hdist - 1] == 0)
+        hdist--;
+
+    // run-length encode code lengths with code-length symbols 16 (repeat), 17 and 18 (zeros)
+    uint8_t packed[ATLASC__DEFLATE_NUM_LITLENS + ATLASC__DEFLATE_NUM_DISTS];
+    uint8_t rle[ATLASC__DEFLATE_NUM_LITLENS + ATLASC__DEFLATE_NUM_DISTS];
+    uint8_t rle_extra[ATLASC__DEFLATE_NUM_LITLENS + ATLASC__DEFLATE_NUM_DISTS];
+    uint32_t cl_freqs[19] = { 0 };
+    int num_packed = hlit + hdist;
+    int num_rle = 0;
+    sx_memcpy(packed, lengths, hlit);
+    sx_memcpy(packed + hlit, dist_lengths, hdist);
+    for (int i = 0; i < num_packed;) {
+        int len = packed[i];
+        int run = 1;
+        while (i + run < num_packed && packed[i + run] == len)
+            run++;
+
+        if (len == 0 && run >= 3) {
+            int r = sx_min(run, 138);
+            rle[num_rle] = r >= 11 ? 18 : 17;
+            rle_extra[num_rle++] = (uint8_t)(r - (r >= 11 ? 11 : 3));
+            i += r;
+        } else {
+            rle[num_rle] = (uint8_t)len;
+            rle_extra[num_rle++] = 0;
+            i++;
+            for (run--; len != 0 && run >= 3; run -= sx_min(run, 6)) {
+                rle[num_rle] = 16;
+                rle_extra[num_rle++] = (uint8_t)(sx_min(run, 6) - 3);
+                i += sx_min(run, 6);
+            }
+        }
+    }
+    for (int i = 0; i < num_rle; i++)
+        cl_freqs[rle[i]]++;
+
+    uint8_t cl_lengths[19];
+    uint16_t cl_codes[19];
+    atlasc__huff_lengths(cl_freqs, 19, 7, cl_lengths);
+    int hclen = 19;
+    while (hclen > 4 && cl_lengths[g_deflate_cl_order[hclen - 1]] == 0)
+        hclen--;
+
+    static const uint8_t cl_extra[19] = { [16] = 2, [17] = 3, [18] = 7 };
+    uint32_t bits = 3 + 5 + 5 + 4 + 3 * hclen;
+    for (int i = 0; i < num_rle; i++)
+        bits += cl_lengths[rle[i]] + cl_extra[rle[i]];
+    for (int i = 0; i < ATLASC__DEFLATE_NUM_LITLENS; i++)
+        bits += lit_freqs[i] * lengths[i];
+    for (int i = 0; i < 29; i++)
+        bits += lit_freqs[257 + i] * g_deflate_len_extra[i];
+    for (int i = 0; i < ATLASC__DEFLATE_NUM_DISTS; i++)
+        bits += dist_freqs[i] * (dist_lengths[i] + g_deflate_dist_extra[i]);
+
+    if (!bw)
+        return bits;
+
+    uint16_t codes[ATLASC__DEFLATE_NUM_LITLENS + ATLASC__DEFLATE_NUM_DISTS];
+    uint16_t* dist_codes = codes + ATLASC__DEFLATE_NUM_LITLENS;
+    atlasc__huff_codes(lengths, ATLASC__DEFLATE_NUM_LITLENS, codes);
+    atlasc__huff_codes(dist_lengths, ATLASC__DEFLATE_NUM_DISTS, dist_codes);
+    atlasc__huff_codes(cl_lengths, 19, cl_codes);
+
+    atlasc__bits_put(bw, final ? 1 : 0, 1);
+    atlasc__bits_put(bw, 2, 2);
+    atlasc__bits_put(bw, hlit - 257, 5);
+    atlasc__bits_put(bw, hdist - 1, 5);
+    atlasc__bits_put(bw, hclen - 4, 4);
+    for (int i = 0; i < hclen; i++)
+        atlasc__bits_put(bw, cl_lengths[g_deflate_cl_order[i]], 3);
+    for (int i = 0; i < num_rle; i++) {
+        atlasc__bits_put(bw, cl_codes[rle[i]], cl_lengths[rle[i]]);
+        if (cl_extra[rle[i]])
+            atlasc__bits_put(bw, rle_extra[i], cl_extra[rle[i]]);
+    }
+
+    for (int i = 0; i < num_syms; i++) {
+        int litlen = syms[i].litlen;
+        if (syms[i].dist == 0) {
+            atlasc__bits_put(bw, codes[litlen], lengths[litlen]);
+        } else {
+            int ls = g_deflate_len_sym[litlen];
+            int ds = atlasc__deflate_dist_sym(syms[i].dist);
+            atlasc__bits_put(bw, codes[257 + ls], lengths[257 + ls]);
+            atlasc__bits_put(bw, litlen - g_deflate_len_base[ls], g_deflate_len_extra[ls]);
+            atlasc__bits_put(bw, dist_codes[ds], dist_lengths[ds]);
+            atlasc__bits_put(bw, syms[i].dist - g_deflate_dist_base[ds], g_deflate_dist_extra[ds]);
+        }
+    }
+    atlasc__bits_put(bw, codes[256], lengths[256]);
+    return bits;
+}
+
+// writes `syms` as one block, or as two halves (recursively) if that comes out smaller
+static void atlasc__deflate_split(atlasc__bit_writer* bw, const atlasc__deflate_sym* syms,
+                                  int num_syms, int depth, bool final)
+{
+    if (depth > 0 && num_syms > 1024) {
+        int half = num_syms / 2;
+        uint32_t whole = atlasc__deflate_block(NULL, syms, num_syms, final);
+        uint32_t split = atlasc__deflate_block(NULL, syms, half, false) +
+                         atlasc__deflate_block(NULL, syms + half, num_syms - half, final);
+        if (split < whole) {
+            atlasc__deflate_split(bw, syms, half, depth - 1, false);
+            atlasc__deflate_split(bw, syms + half, num_syms - half, depth - 1, final);
+            return;
+        }
+    }
+    atlasc__deflate_block(bw, syms, num_syms, final);
+}
+
+// first pass assumes the fixed huffman code, later passes use the entropy of the previous one
+static void atlasc__deflate_update_costs(atlasc__deflate_costs* costs,
+                                         const atlasc__deflate_sym* syms, int num_syms)
+{
+    float lit[ATLASC__DEFLATE_NUM_LITLENS];
+    float dist[ATLASC__DEFLATE_NUM_DISTS];
+
+    if (syms) {
+        uint32_t lit_freqs[ATLASC__DEFLATE_NUM_LITLENS];
+        uint32_t dist_freqs[ATLASC__DEFLATE_NUM_DISTS];
+        uint32_t lit_total = 0, dist_total = 0;
+        atlasc__deflate_freqs(syms, num_syms, lit_freqs, dist_freqs);
+        for (int i = 0; i < ATLASC__DEFLATE_NUM_LITLENS; i++)
+            lit_total += lit_freqs[i];
+        for (int i = 0; i < ATLASC__DEFLATE_NUM_DISTS; i++)
+            dist_total += dist_freqs[i];
+
+        // unused symbols are priced as if they were seen once
+        float lit_log = sx_log2((float)lit_total);
+        float dist_log = sx_log2((float)dist_total);
+        for (int i = 0; i < ATLASC__DEFLATE_NUM_LITLENS; i++)
+            lit[i] = lit_log - (lit_freqs[i] ? sx_log2((float)lit_freqs[i]) : 0.0f);
+        for (int i = 0; i < ATLASC__DEFLATE_NUM_DISTS; i++) {
+            float c = dist_log - (dist_freqs[i] ? sx_log2((float)dist_freqs[i]) : 0.0f);
+            dist[i] = dist_total ? c : 5.0f;
+        }
+    } else {
+        for (int i = 0; i < ATLASC__DEFLATE_NUM_LITLENS; i++)
+            lit[i] = i < 144 ? 8.0f : (i < 256 ? 9.0f : (i < 280 ? 7.0f : 8.0f));
+        for (int i = 0; i < ATLASC__DEFLATE_NUM_DISTS; i++)
+            dist[i] = 5.0f;
+    }
+
+    sx_memcpy(costs->lit, lit, sizeof(costs->lit));
+    for (int l = 3; l <= ATLASC__DEFLATE_MAX_MATCH; l++) {
+        int ls = g_deflate_len_sym[l];
+        costs->len[l] = lit[257 + ls] + (float)g_deflate_len_extra[ls];
+    }
+    for (int i = 0; i < ATLASC__DEFLATE_NUM_DISTS; i++)
+        costs->dist[i] = dist[i] + (float)g_deflate_dist_extra[i];
+}
+
+// collects the matches of every position in [start, end) that get longer as distance grows,
+// packed as (dist << 9) | len. matches of position `i` are in [offsets[i], offsets[i + 1])
+static bool atlasc__deflate_find_matches(const uint8_t* data, int start, int end,
+                                         uint32_t* offsets, uint32_t** pmatches)
+{
+    const int hash_size = 1 << ATLASC__DEFLATE_HASH_BITS;
+    int base = sx_max(0, start - ATLASC__DEFLATE_WINDOW);
+    int* head = atlasc__malloc(sizeof(int) * hash_size, g_alloc_ctx);
+    int* prev = atlasc__malloc(sizeof(int) * (end - base), g_alloc_ctx);
+    uint32_t* matches = NULL;
+    if (!head || !prev) {
+        atlasc__free(head, g_alloc_ctx);
+        atlasc__free(prev, g_alloc_ctx);
+        return false;
+    }
+    sx_memset(head, 0xff, sizeof(int) * hash_size);
+
+    for (int p = base; p < end; p++) {
+        uint32_t h = 0;
+        bool hashable = p + 3 <= end;
+        if (hashable) {
+            h = ((uint32_t)data[p] << 16) | ((uint32_t)data[p + 1] << 8) | data[p + 2];
+            h = (h * 2654435761u) >> (32 - ATLASC__DEFLATE_HASH_BITS);
+        }
+
+        if (p >= start) {
+            offsets[p - start] = (uint32_t)sx_array_count(matches);
+            int max_len = sx_min(ATLASC__DEFLATE_MAX_MATCH, end - p);
+            int best = 2;
+            int num_entries = 0;
+            int cand = hashable ? head[h] : -1;
+            for (int chain = ATLASC__DEFLATE_MAX_CHAIN;
+                 cand >= 0 && p - cand <= ATLASC__DEFLATE_WINDOW && chain > 0;
+                 cand = prev[cand - base], chain--) {
+                if (data[cand + best] != data[p + best])
+                    continue;
+                int len = 0;
+                while (len < max_len && data[cand + len] == data[p + len])
+                    len++;
+                if (len > best) {
+                    uint32_t m = ((uint32_t)(p - cand) << 9) | (uint32_t)len;
+                    best = len;
+                    if (num_entries < ATLASC__DEFLATE_MAX_ENTRIES) {
+                        sx_array_push(g_alloc, matches, m);
+                        num_entries++;
+                    } else {
+                        matches[sx_array_count(matches) - 1] = m;
+                    }
+                    if (len >= sx_min(max_len, ATLASC__DEFLATE_NICE_MATCH))
+                        break;
+                    if (len >= ATLASC__DEFLATE_GOOD_MATCH && chain > ATLASC__DEFLATE_MAX_CHAIN / 4)
+                        chain = ATLASC__DEFLATE_MAX_CHAIN / 4;
+                }
+            }
+        }
+
+        if (hashable) {
+            prev[p - base] = head[h];
+            head[h] = p;
+        } else {
+            prev[p - base] = -1;
+        }
+    }
+    offsets[end - start] = (uint32_t)sx_array_count(matches);
+
+    atlasc__free(head, g_alloc_ctx);
+    atlasc__free(prev, g_alloc_ctx);
+    *pmatches = matches;
+    return true;
+}
+
+// shortest path over the match graph with the given cost model, returns number of symbols
+static int atlasc__deflate_parse(const uint8_t* data, int size, const uint32_t* offsets,
+                                 const uint32_t* matches, const atlasc__deflate_costs* costs,
+                                 float* cost, uint32_t* choice, atlasc__deflate_sym* syms)
+{
+    cost[0] = 0;
+    for (int i = 1; i <= size; i++)
+        cost[i] = 1e30f;
+
+    for (int i = 0; i < size; i++) {
+        float c = cost[i] + costs->lit[data[i]];
+        if (c < cost[i + 1]) {
+            cost[i + 1] = c;
+            choice[i + 1] = 1;
+        }
+
+        int prev_len = 2;
+        for (uint32_t k = offsets[i]; k < offsets[i + 1]; k++) {
+            int len = (int)(matches[k] & 0x1ff);
+            int dist = (int)(matches[k] >> 9);
+            float dc = cost[i] + costs->dist[atlasc__deflate_dist_sym(dist)];
+            // long runs only try the full length, otherwise it's quadratic over the run
+            for (int l = len == ATLASC__DEFLATE_MAX_MATCH ? len : prev_len + 1; l <= len; l++) {
+                float mc = dc + costs->len[l];
+                if (mc < cost[i + l]) {
+                    cost[i + l] = mc;
+                    choice[i + l] = ((uint32_t)dist << 9) | (uint32_t)l;
+                }
+            }
+            prev_len = len;
+        }
+    }
+
+    int num_syms = 0;
+    for (int i = size; i > 0;) {
+        int len = (int)(choice[i] & 0x1ff);
+        int dist = (int)(choice[i] >> 9);
+        i -= len;
+        syms[num_syms++] = (atlasc__deflate_sym){ .litlen = dist ? (uint16_t)len : data[i],
+                                                  .dist = (uint16_t)dist };
+    }
+    for (int i = 0, j = num_syms - 1; i < j; i++, j--) {
+        atlasc__deflate_sym tmp = syms[i];
+        syms[i] = syms[j];
+        syms[j] = tmp;
+    }
+    return num_syms;
+}
+
+static void atlasc__png_deflate_job(int index, void* user)
+{
+    atlasc__png_job* job = user;
+    if (job->skip[index / job->num_chunks])
+        return;
+    const uint8_t* data = job->filtered[index / job->num_chunks];
+    int chunk = index % job->num_chunks;
+    int start = chunk * ATLASC__DEFLATE_CHUNK_SIZE;
+    int end = sx_min(start + ATLASC__DEFLATE_CHUNK_SIZE, job->data_size);
+    int size = end - start;
+    bool last = chunk == job->num_chunks - 1;
+
+    atlasc__deflate_costs costs;
+    uint32_t* offsets = atlasc__malloc(sizeof(uint32_t) * (size + 1), g_alloc_ctx);
+    uint32_t* choice = atlasc__malloc(sizeof(uint32_t) * (size + 1), g_alloc_ctx);
+    float* cost = atlasc__malloc(sizeof(float) * (size + 1), g_alloc_ctx);
+    atlasc__deflate_sym* syms = atlasc__malloc(sizeof(atlasc__deflate_sym) * size, g_alloc_ctx);
+    atlasc__deflate_sym* best = atlasc__malloc(sizeof(atlasc__deflate_sym) * size, g_alloc_ctx);
+    uint32_t* matches = NULL;
+    if (offsets && choice && cost && syms && best &&
+        atlasc__deflate_find_matches(data, start, end, offsets, &matches)) {
+        uint32_t best_bits = UINT32_MAX;
+        int num_best = 0;
+        atlasc__deflate_update_costs(&costs, NULL, 0);
+        for (int it = 0; it < ATLASC__DEFLATE_ITERATIONS; it++) {
+            int num_syms = atlasc__deflate_parse(data + start, size, offsets, matches, &costs,
+                                                 cost, choice, syms);
+            uint32_t bits = atlasc__deflate_block(NULL, syms, num_syms, last);
+            if (bits < best_bits) {
+                best_bits = bits;
+                num_best = num_syms;
+                sx_memcpy(best, syms, sizeof(atlasc__deflate_sym) * num_syms);
+            }
+            atlasc__deflate_update_costs(&costs, syms, num_syms);
+        }
+
+        atlasc__bit_writer bw = { .writer = &job->chunks[index] };
+        atlasc__deflate_split(&bw, best, num_best, ATLASC__DEFLATE_SPLIT_DEPTH, last);
+        if (!last) {
+            // empty stored block: byte aligns the stream so the next chunk can be appended
+            static const uint8_t sync[4] = { 0x00, 0x00, 0xff, 0xff };
+            atlasc__bits_put(&bw, 0, 3);
+            atlasc__bits_align(&bw);
+            sx_mem_write(bw.writer, sync, sizeof(sync));
+        } else {
+            atlasc__bits_align(&bw);
+        }
+    } else {
+        job->skip[index / job->num_chunks] = 1;
+    }
+
+    sx_array_free(g_alloc, matches);
+    atlasc__free(offsets, g_alloc_ctx);
+    atlasc__free(choice, g_alloc_ctx);
+    atlasc__free(cost, g_alloc_ctx);
+    atlasc__free(syms, g_alloc_ctx);
+    atlasc__free(best, g_alloc_ctx);
+}
+
+// sum of absolute residuals, bytes are taken as signed
+static uint32_t atlasc__png_row_sum(const int8_t* row, int size)
+{
+    uint32_t sum = 0;
+    int i = 0;
+#if ATLASC__SSE2
+    __m128i zero = _mm_setzero_si128();
+    __m128i acc = zero;
+    for (; i + 16 <= size; i += 16) {
+        __m128i v = _mm_loadu_si128((const __m128i*)(row + i));
+        __m128i a = _mm_min_epu8(v, _mm_sub_epi8(zero, v));
+        acc = _mm_add_epi64(acc, _mm_sad_epu8(a, zero));
+    }
+    sum = (uint32_t)(_mm_cvtsi128_si32(acc) + _mm_cvtsi128_si32(_mm_srli_si128(acc, 8)));
+#endif
+    for (; i < size; i++)
+        sum += (uint32_t)(row[i] < 0 ? -row[i] : row[i]);
+    return sum;
+}
+
+static float atlasc__png_row_entropy(const int8_t* row, int size)
+{
+    uint32_t hist[256] = { 0 };
+    for (int i = 0; i < size; i++)
+        hist[(uint8_t)row[i]]++;
+    float log_size = sx_log2((float)size);
+    float bits = 0;
+    for (int i = 0; i < 256; i++) {
+        if (hist[i])
+            bits += (float)hist[i] * (log_size - sx_log2((float)hist[i]));
+    }
+    return bits;
+}
+
+static void atlasc__png_filter_job(int index, void* user)
+{
+    atlasc__png_job* job = user;
+    int stride = job->width * 4;
+    unsigned char* pixels = (unsigned char*)job->pixels;
+
+    for (int y = 0; y < job->height; y++) {
+        uint8_t* line = job->filtered[index] + y * (stride + 1);
+        signed char* residuals = (signed char*)line + 1;
+        int filter = index == ATLASC__PNG_STRATEGY_PAETH ? 4 : 0;
+        if (index == ATLASC__PNG_STRATEGY_MINSUM || index == ATLASC__PNG_STRATEGY_ENTROPY) {
+            float best_cost = 1e30f;
+            for (int f = 0; f < 5; f++) {
+                stbiw__encode_png_line(pixels, stride, job->width, job->height, y, 4, f,
+                                       residuals);
+                float c = index == ATLASC__PNG_STRATEGY_MINSUM
+                              ? (float)atlasc__png_row_sum((const int8_t*)residuals, stride)
+                              : atlasc__png_row_entropy((const int8_t*)residuals, stride);
+                if (c < best_cost) {
+                    best_cost = c;
+                    filter = f;
+                }
+            }
+        }
+        stbiw__encode_png_line(pixels, stride, job->width, job->height, y, 4, filter, residuals);
+        line[0] = (uint8_t)filter;
+    }
+}
+
+static uint32_t atlasc__adler32(const uint8_t* data, int size)
+{
+    uint32_t a = 1, b = 0;
+    while (size > 0) {
+        int n = sx_min(size, 5552);
+        size -= n;
+        for (; n > 0; n--) {
+            a += *data++;
+            b += a;
+        }
+        a %= 65521;
+        b %= 65521;
+    }
+    return (b << 16) | a;
+}
+
+static void atlasc__write_be32(sx_mem_writer* writer, uint32_t v)
+{
+    uint8_t b[4] = { (uint8_t)(v >> 24), (uint8_t)(v >> 16), (uint8_t)(v >> 8), (uint8_t)v };
+    sx_mem_write(writer, b, sizeof(b));
+}
+
+static void atlasc__png_write_chunk(sx_mem_writer* writer, const char* tag, const void* data,
+                                    int size)
+{
+    atlasc__write_be32(writer, (uint32_t)size);
+    sx_mem_write(writer, tag, 4);
+    sx_mem_write(writer, data, size);
+    atlasc__write_be32(writer, sx_hash_crc32(data, size, sx_hash_crc32(tag, 4, 0)));
+}
+
+// encodes 32bpp `pixels` into `out` as the smallest png of all filter strategies
+static bool atlasc__png_optimize(const uint8_t* pixels, int w, int h, sx_mem_writer* out)
+{
+    atlasc__png_job job = { .pixels = pixels, .width = w, .height = h };
+    job.data_size = h * (w * 4 + 1);
+    job.num_chunks = (job.data_size + ATLASC__DEFLATE_CHUNK_SIZE - 1) / ATLASC__DEFLATE_CHUNK_SIZE;
+    int num_jobs = ATLASC__PNG_STRATEGY_COUNT * job.num_chunks;
+    bool r = false;
+
+    atlasc__deflate_init();
+    job.chunks = atlasc__malloc(sizeof(sx_mem_writer) * num_jobs, g_alloc_ctx);
+    for (int i = 0; i < ATLASC__PNG_STRATEGY_COUNT; i++)
+        job.filtered[i] = atlasc__malloc(job.data_size, g_alloc_ctx);
+    for (int i = 0; i < ATLASC__PNG_STRATEGY_COUNT; i++) {
+        if (!job.filtered[i] || !job.chunks) {
+            sx_out_of_memory();
+            goto cleanup;
+        }
+    }
+    for (int i = 0; i < num_jobs; i++)
+        sx_mem_init_writer(&job.chunks[i], g_alloc, 0);
+
+    if (!atlasc__parallel_for(atlasc__png_filter_job, &job, ATLASC__PNG_STRATEGY_COUNT))
+        goto cleanup;
+    for (int s = 1; s < ATLASC__PNG_STRATEGY_COUNT; s++) {
+        for (int k = 0; k < s && !job.skip[s]; k++)
+            job.skip[s] = sx_memcmp(job.filtered[s], job.filtered[k], job.data_size) == 0;
+    }
+    if (!atlasc__parallel_for(atlasc__png_deflate_job, &job, num_jobs))
+        goto cleanup;
+
+    int best = -1;
+    int64_t best_size = INT64_MAX;
+    for (int s = 0; s < ATLASC__PNG_STRATEGY_COUNT; s++) {
+        int64_t size = 0;
+        for (int c = 0; c < job.num_chunks; c++)
+            size += job.chunks[s * job.num_chunks + c].pos;
+        if (!job.skip[s] && size < best_size) {
+            best = s;
+            best_size = size;
+        }
+    }
+    if (best == -1) {
+        sx_out_of_memory();
+        goto cleanup;
+    }
+
+    sx_mem_writer idat;
+    static const uint8_t png_sig[8] = { 0x89, 'P', 'N', 'G', '\r', '\n', 0x1a, '\n' };
+    static const uint8_t zlib_header[2] = { 0x78, 0xda };
+    uint8_t ihdr[13] = { 0, 0, 0, 0, 0, 0, 0, 0, 8, 6, 0, 0, 0 };    // 8bit RGBA
+    ihdr[0] = (uint8_t)(w >> 24), ihdr[1] = (uint8_t)(w >> 16);
+    ihdr[2] = (uint8_t)(w >> 8), ihdr[3] = (uint8_t)w;
+    ihdr[4] = (uint8_t)(h >> 24), ihdr[5] = (uint8_t)(h >> 16);
+    ihdr[6] = (uint8_t)(h >> 8), ihdr[7] = (uint8_t)h;
+
+    sx_mem_init_writer(&idat, g_alloc, (int)best_size + 6);
+    sx_mem_write(&idat, zlib_header, sizeof(zlib_header));
+    for (int c = 0; c < job.num_chunks; c++) {
+        const sx_mem_writer* chunk = &job.chunks[best * job.num_chunks + c];
+        sx_mem_write(&idat, chunk->data, (int)chunk->pos);
+    }
+    atlasc__write_be32(&idat, atlasc__adler32(job.filtered[best], job.data_size));
+
+    // the deflate encoder is our own, so its output is decoded back with stb_image before it's
+    // written. it's a fraction of the search time
+    int decoded_size;
+    char* decoded = stbi_zlib_decode_malloc((const char*)idat.data, (int)idat.pos, &decoded_size);
+    bool valid = decoded && decoded_size == job.data_size &&
+                 sx_memcmp(decoded, job.filtered[best], job.data_size) == 0;
+    stbi_image_free(decoded);
+    if (!valid) {
+        sx_assert(0 && "deflate stream does not decode to the input");
+        sx_snprintf(g_error_str, sizeof(g_error_str), "optimized png is corrupt");
+        sx_mem_release_writer(&idat);
+        goto cleanup;
+    }
+
+    sx_mem_write(out, png_sig, sizeof(png_sig));
+    atlasc__png_write_chunk(out, "IHDR", ihdr, sizeof(ihdr));
+    atlasc__png_write_chunk(out, "IDAT", idat.data, (int)idat.pos);
+    atlasc__png_write_chunk(out, "IEND", NULL, 0);
+    sx_mem_release_writer(&idat);
+    r = true;
+
+cleanup:
+    if (job.chunks) {
+        for (int i = 0; i < num_jobs; i++)
+            sx_mem_release_writer(&job.chunks[i]);
+        atlasc__free(job.chunks, g_alloc_ctx);
+    }
+    for (int i = 0; i < ATLASC__PNG_STRATEGY_COUNT; i++)
+        atlasc__free(job.filtered[i], g_alloc_ctx);
+    return r;
+}
+
+// output pixel formats (ATLASC_FORMAT_*), 16bit formats are DXGI B5G6R5, B4G4R4A4 and B5G5R5A1
+typedef struct atlasc__format_desc {
+    const char* name;
+    int bytes;       // per pixel
+    int bits[4];     // R, G, B, A. 0 = dropped channel
+    int shift[4];    // position of the channels in the packed texel
+    uint32_t dxgi_format;
+} atlasc__format_desc;
+
+static const atlasc__format_desc g_formats[ATLASC_FORMAT_COUNT] = {
+    { "rgba8", 4, { 8, 8, 8, 8 }, { 0, 8, 16, 24 }, 28 },
+    { "rgb565", 2, { 5, 6, 5, 0 }, { 11, 5, 0, 0 }, 85 },
+    { "rgba4444", 2, { 4, 4, 4, 4 }, { 8, 4, 0, 12 }, 115 },
+    { "rgba5551", 2, { 5, 5, 5, 1 }, { 10, 5, 0, 15 }, 86 },
+};
+
+static const int g_bayer4x4[4][4] = {
+    { 0, 8, 2, 10 }, { 12, 4, 14, 6 }, { 3, 11, 1, 9 }, { 15, 7, 13, 5 }
+};
+
+// quantizes the RGBA8 pixels of a sprite in place to the precision of `format`. values stay 8bit
+// (v = round(q * 255 / max)) and are packed exactly by `atlasc__pack_pixels`. transparent texels
+// are left out and the error is only diffused inside the rect, so it doesn't cross the gutters
+static bool atlasc__quantize_rect(uint8_t* pixels, int pitch, sx_irect rc, int format, int dither)
+{
+    const atlasc__format_desc* fmt = &g_formats[format];
+    int w = rc.xmax - rc.xmin;
+    int err_count = (w + 2) * 4;
+    int* errors = NULL;    // two rows of diffused error, in 1/256 units
+    if (dither == ATLASC_DITHER_DIFFUSE) {
+        errors = atlasc__malloc(sizeof(int) * err_count * 2, g_alloc_ctx);
+        if (!errors) {
+            sx_out_of_memory();
+            return false;
+        }
+        sx_memset(errors, 0x0, sizeof(int) * err_count * 2);
+    }
+
+    for (int y = rc.ymin; y < rc.ymax; y++) {
+        uint8_t* row = pixels + (size_t)y * pitch + rc.xmin * 4;
+        int* cur = errors ? errors + ((y - rc.ymin) & 1) * err_count + 4 : NULL;
+        int* next = errors ? errors + (~(y - rc.ymin) & 1) * err_count + 4 : NULL;
+        if (next)
+            sx_memset(next - 4, 0x0, sizeof(int) * err_count);
+
+        for (int x = 0; x < w; x++) {
+            uint8_t* p = row + x * 4;
+            if (p[3] == 0)
+                continue;
+
+            for (int c = 0; c < 4; c++) {
+                int bits = fmt->bits[c];
+                if (bits == 0 || bits == 8)
+                    continue;
+                int max = (1 << bits) - 1;
+
+                // 1/16 units, 1bit channels are only thresholded
+                int v = p[c] * 16;
+                if (bits > 1 && dither == ATLASC_DITHER_ORDERED)
+                    v += (g_bayer4x4[y & 3][(rc.xmin + x) & 3] * 2 - 15) * 255 / (max * 2);
+                else if (bits > 1 && cur)
+                    v += cur[x * 4 + c] / 16;
+                v = sx_clamp(v, 0, 255 * 16);
+
+                int q = (v * max + 255 * 8) / (255 * 16);
+                p[c] = (uint8_t)((q * 255 + max / 2) / max);
+
+                // floyd-steinberg
+                if (bits > 1 && next) {
+                    int e = v - p[c] * 16;
+                    cur[(x + 1) * 4 + c] += e * 7;
+                    next[(x - 1) * 4 + c] += e * 3;
+                    next[x * 4 + c] += e * 5;
+                    next[(x + 1) * 4 + c] += e;
+                }
+            }
+            if (p[3] == 0)
+                sx_memset(p, 0x0, 4);
+        }
+    }
+
+    atlasc__free(errors, g_alloc_ctx);
+    return true;
+}
+
+// round(x / 255) for x in [0, 65535]
+#define ATLASC__DIV255(_x) (((_x) + 128 + (((_x) + 128) >> 8)) >> 8)
+
+// packs quantized RGBA8 pixels into a 16bit `format`
+static void atlasc__pack_pixels(uint16_t* dst, const uint8_t* src, size_t count, int format)
+{
+    const atlasc__format_desc* fmt = &g_formats[format];
+    const uint32_t* pixels = (const uint32_t*)src;
+    size_t i = 0;
+#if ATLASC__SSE2
+    const __m128i mask = _mm_set1_epi32(0xff);
+    const __m128i half = _mm_set1_epi32(128);
+    for (; i + 8 <= count; i += 8) {
+        __m128i packed[2];
+        for (int k = 0; k < 2; k++) {
+            __m128i v = _mm_loadu_si128((const __m128i*)(pixels + i + k * 4));
+            __m128i r = _mm_setzero_si128();
+            for (int c = 0; c < 4; c++) {
+                if (fmt->bits[c] == 0)
+                    continue;
+                __m128i ch = _mm_and_si128(_mm_srl_epi32(v, _mm_cvtsi32_si128(c * 8)), mask);
+                __m128i x = _mm_add_epi32(
+                    _mm_mullo_epi16(ch, _mm_set1_epi32((1 << fmt->bits[c]) - 1)), half);
+                x = _mm_srli_epi32(_mm_add_epi32(x, _mm_srli_epi32(x, 8)), 8);
+                r = _mm_or_si128(r, _mm_sll_epi32(x, _mm_cvtsi32_si128(fmt->shift[c])));
+            }
+            // sign extend, so packs doesn't saturate the texels with the top bit set
+            packed[k] = _mm_srai_epi32(_mm_slli_epi32(r, 16), 16);
+        }
+        _mm_storeu_si128((__m128i*)(dst + i), _mm_packs_epi32(packed[0], packed[1]));
+    }
+#endif
+    for (; i < count; i++) {
+        uint32_t r = 0;
+        for (int c = 0; c < 4; c++) {
+            if (fmt->bits[c] == 0)
+                continue;
+            uint32_t x = ((pixels[i] >> (c * 8)) & 0xff) * ((1u << fmt->bits[c]) - 1);
+            r |= ATLASC__DIV255(x) << fmt->shift[c];
+        }
+        dst[i] = (uint16_t)r;
+    }
+}
+
+// texture (array) in `format`: DDS header, DX10 header and the layers, without mips
+static bool atlasc__save_dds(const char* filepath, const void* pixels, int w, int h,
+                             int num_layers, int format)
+{
+    const atlasc__format_desc* fmt = &g_formats[format];
+    uint32_t hdr[37] = { 0 };
+    hdr[0] = ATLASC__DDS_MAGIC;
+    hdr[1] = 124;
+    hdr[2] = 0x1 | 0x2 | 0x4 | 0x8 | 0x1000;    // CAPS | HEIGHT | WIDTH | PITCH | PIXELFORMAT
+    hdr[3] = (uint32_t)h;
+    hdr[4] = (uint32_t)w;
+    hdr[5] = (uint32_t)(w * fmt->bytes);
+    hdr[7] = 1;                   // mip count
+    hdr[19] = 32;                 // pixel format size
+    hdr[20] = 0x4;                // DDPF_FOURCC
+    hdr[21] = ATLASC__DDS_DX10;
+    hdr[27] = 0x1000;             // DDSCAPS_TEXTURE
+    hdr[32] = fmt->dxgi_format;
+    hdr[33] = 3;                  // D3D10_RESOURCE_DIMENSION_TEXTURE2D
+    hdr[35] = (uint32_t)num_layers;
+
+    sx_file_writer writer;
+    if (!sx_file_open_writer(&writer, filepath, 0)) {
+        printf("could not open file for writing: %s\n", filepath);
+        return false;
+    }
+    // written a page at a time, the whole array can be larger than sx_file_write takes
+    int page_size = w * h * fmt->bytes;
+    bool r = sx_file_write(&writer, hdr, sizeof(hdr)) == (int)sizeof(hdr);
+    for (int i = 0; i < num_layers && r; i++)
+        r = sx_file_write(&writer, (const uint8_t*)pixels + (size_t)i * page_size, page_size) ==
+            page_size;
+    sx_file_close_writer(&writer);
+    if (!r)
+        printf("could not write image: %s\n", filepath);
+    return r;
+}
+
+static bool atlasc__save(const atlasc_args_files* args, const atlasc_atlas_data* atlas)
+{
+    char file_ext[32];
+    char basename[256];
+    char image_filepath[256];
+    char image_filename[256];
+    const atlasc_sprite* sprites = atlas->sprites;
+    const uint8_t* dst = atlas->atlas_image.pixels;
+    int num_sprites = atlas->num_sprites;
+    int dst_w = atlas->atlas_image.width;
+    int dst_h = atlas->atlas_image.height;
+    int num_layers = atlas->num_layers;
+
+    sx_os_path_splitext(file_ext, sizeof(file_ext), basename, sizeof(basename), args->out_filepath);
+    int format = args->common.format;
+    const char* image_ext = args->common.array || format != ATLASC_FORMAT_RGBA8 ? ".dds" : ".png";
+    sx_strcpy(image_filepath, sizeof(image_filepath), basename);
+    sx_strcat(image_filepath, sizeof(image_filepath), image_ext);
+
+    atlasc__patch_prev prev = { 0 };
+    if (args->patch_from && !atlasc__patch_prev_load(&prev, args->patch_from, image_ext))
+        return false;
+
+    ATLASC__ZONE_BEGIN("encode");
+    bool r = true;
+    if (format != ATLASC_FORMAT_RGBA8) {
+        size_t count = (size_t)dst_w * dst_h * num_layers;
+        uint16_t* packed = atlasc__malloc(sizeof(uint16_t) * count, g_alloc_ctx);
+        if (!packed) {
+            sx_out_of_memory();
+            ATLASC__ZONE_END("encode", 0, 0);
+            atlasc__patch_prev_release(&prev);
+            return false;
+        }
+        atlasc__pack_pixels(packed, dst, count, format);
+        r = atlasc__save_dds(image_filepath, packed, dst_w, dst_h, num_layers, format);
+        atlasc__free(packed, g_alloc_ctx);
+    } else if (args->common.array) {
+        r = atlasc__save_dds(image_filepath, dst, dst_w, dst_h, num_layers, format);
+    } else if (args->common.optimize) {
+        sx_mem_writer png;
+        sx_mem_init_writer(&png, g_alloc, 0);
+        r = atlasc__png_optimize(dst, dst_w, dst_h, &png) &&
+            atlasc__write_desc(image_filepath, png.data, (int)png.pos, false);
+        if (!r)
+            printf("could not write image: %s\n", image_filepath);
+        sx_mem_release_writer(&png);
+    } else if (!stbi_write_png(image_filepath, dst_w, dst_h, 4, dst, dst_w * 4)) {
+        printf("could not write image: %s\n", image_filepath);
+        r = false;
+    }
+    ATLASC__ZONE_END("encode", r ? num_layers : 0, r ? sx_os_stat(image_filepath).size : 0);
+    if (!r) {
+        atlasc__patch_prev_release(&prev);
+        return false;
+    }
+    sx_os_path_basename(image_filename, sizeof(image_filename), image_filepath);
+
+    // write atlas description into json/binary file
+    ATLASC__ZONE_BEGIN("descriptor");
+    sx_mem_writer desc;
+    sx_mem_init_writer(&desc, g_alloc, 0);
+    const atlasc_palette* palettes = atlas->palettes;
+    int num_palettes = atlas->num_palettes;
+    if (args->common.binary) {
+        r = atlasc__save_bin(args, sprites, num_sprites, palettes, num_palettes, image_filename,
+                             dst_w, dst_h, &desc);
+    } else if (args->common.compact) {
+        r = atlasc__save_json_compact(args, sprites, num_sprites, palettes, num_palettes,
+                                      image_filename, dst_w, dst_h, &desc);
+    } else {
+        r = atlasc__save_json(args, sprites, num_sprites, palettes, num_palettes, image_filename,
+                              dst_w, dst_h, &desc);
+    }
+
+    if (r) {
+        r = atlasc__write_desc(args->out_filepath, desc.data, (int)desc.pos, args->common.compress);
+    }
+
+    if (r && args->patch_from) {
+        char patch_filepath[256];
+        sx_strcpy(patch_filepath, sizeof(patch_filepath), basename);
+        sx_strcat(patch_filepath, sizeof(patch_filepath), ".patch");
+        r = atlasc__save_patch(patch_filepath, &prev, desc.data, (int)desc.pos, dst, dst_w,
+                               dst_h * num_layers);
+    }
+    ATLASC__ZONE_END("descriptor", num_sprites, desc.pos);
+
+    sx_mem_release_writer(&desc);
+    atlasc__patch_prev_release(&prev);
+    return r;
+}
+
+////////////////////////////////////////////////////////////////////////////////////////////////////
+// fast input readers: qoi, raw and uncompressed dds are decoded straight into the sprite buffer,
+// compressed data is read through a scratch buffer that is reused for all inputs. everything else
+// goes through stb_image
+static uint8_t* atlasc__read_buffer_reserve(atlasc__read_buffer* buff, int size)
+{
+    if (size > buff->capacity) {
+        uint8_t* data = atlasc__realloc(buff->data, size, g_alloc_ctx);
+        if (!data) {
+            sx_out_of_memory();
+            return NULL;
+        }
+        buff->data = data;
+        buff->capacity = size;
+    }
+    return buff->data;
+}
+
+static inline uint32_t atlasc__read_le32(const uint8_t* p)
+{
+    return (uint32_t)p[0] | ((uint32_t)p[1] << 8) | ((uint32_t)p[2] << 16) | ((uint32_t)p[3] << 24);
+}
+
+static inline uint32_t atlasc__read_be32(const uint8_t* p)
+{
+    return ((uint32_t)p[0] << 24) | ((uint32_t)p[1] << 16) | ((uint32_t)p[2] << 8) | (uint32_t)p[3];
+}
+
+static uint8_t* atlasc__load_raw(sx_file_reader* reader, int64_t file_size, int offset, int w,
+                                 int h, int* width, int* height)
+{
+    if (w <= 0 || h <= 0 || file_size != offset + (int64_t)w * h * 4)
+        return NULL;
+
+    uint8_t* pixels = atlasc__malloc(w * h * 4, g_alloc_ctx);
+    if (!pixels) {
+        sx_out_of_memory();
+        return NULL;
+    }
+    sx_file_seekr(reader, offset, SX_WHENCE_BEGIN);
+    if (sx_file_read(reader, pixels, w * h * 4) != w * h * 4) {
+        atlasc__free(pixels, g_alloc_ctx);
+        return NULL;
+    }
+    *width = w;
+    *height = h;
+    return pixels;
+}
+
+// headerless raw files keep the size in the name: walk_0001_64x64.rgba
+static bool atlasc__raw_size_from_name(const char* filepath, int* w, int* h)
+{
+    char name[256];
+    sx_os_path_basename(name, sizeof(name), filepath);
+    char* ext = (char*)sx_strrchar(name, '.');
+    if (ext)
+        *ext = '\0';
+
+    const char* x = sx_strrchar(name, 'x');
+    if (!x || !sx_isnumchar(x[1]))
+        return false;
+    const char* start = x;
+    while (start > name && sx_isnumchar(start[-1]))
+        start--;
+    for (const char* c = x + 1; *c; c++) {
+        if (!sx_isnumchar(*c))
+            return false;
+    }
+    if (start == x)
+        return false;
+
+    *w = sx_toint(start);
+    *h = sx_toint(x + 1);
+    return true;
+}
+
+// https://qoiformat.org/qoi-specification.pdf
+static uint8_t* atlasc__load_qoi(sx_file_reader* reader, int64_t file_size, int* width,
+                                 int* height, atlasc__read_buffer* buff)
+{
+    if (file_size < 22 || file_size > INT_MAX)
+        return NULL;
+    int size = (int)file_size;
+    uint8_t* data = atlasc__read_buffer_reserve(buff, size);
+    sx_file_seekr(reader, 0, SX_WHENCE_BEGIN);
+    if (!data || sx_file_read(reader, data, size) != size)
+        return NULL;
+
+    int w = (int)atlasc__read_be32(data + 4);
+    int h = (int)atlasc__read_be32(data + 8);
+    if (w <= 0 || h <= 0 || (int64_t)w * h > INT_MAX / 4)
+        return NULL;
+    uint8_t* pixels = atlasc__malloc(w * h * 4, g_alloc_ctx);
+    if (!pixels) {
+        sx_out_of_memory();
+        return NULL;
+    }
+
+    uint8_t index[64 * 4] = { 0 };
+    uint8_t px[4] = { 0, 0, 0, 255 };
+    int run = 0;
+    int p = 14;
+    int end = size - 8;    // stream is closed by 8 bytes of padding
+    for (int i = 0, n = w * h; i < n; i++) {
+        if (run > 0) {
+            run--;
+        } else if (p < end) {
+            int b1 = data[p++];
+            if (b1 == 0xfe) {
+                px[0] = data[p], px[1] = data[p + 1], px[2] = data[p + 2];
+                p += 3;
+            } else if (b1 == 0xff) {
+                px[0] = data[p], px[1] = data[p + 1], px[2] = data[p + 2], px[3] = data[p + 3];
+                p += 4;
+            } else if ((b1 & 0xc0) == 0x00) {
+                sx_memcpy(px, &index[b1 * 4], 4);
+            } else if ((b1 & 0xc0) == 0x40) {
+                px[0] += ((b1 >> 4) & 0x03) - 2;
+                px[1] += ((b1 >> 2) & 0x03) - 2;
+                px[2] += (b1 & 0x03) - 2;
+            } else if ((b1 & 0xc0) == 0x80) {
+                int b2 = data[p++];
+                int vg = (b1 & 0x3f) - 32;
+                px[0] += vg - 8 + ((b2 >> 4) & 0x0f);
+                px[1] += vg;
+                px[2] += vg - 8 + (b2 & 0x0f);
+            } else {
+                run = b1 & 0x3f;
+            }
+            int hash = (px[0] * 3 + px[1] * 5 + px[2] * 7 + px[3] * 11) % 64;
+            sx_memcpy(&index[hash * 4], px, 4);
+        }
+        sx_memcpy(pixels + i * 4, px, 4);
+    }
+
+    *width = w;
+    *height = h;
+    return pixels;
+}
+
+// uncompressed 24/32bpp dds with byte aligned channel masks, including dx10 RGBA8/BGRA8 formats
+// and texture arrays
+static uint8_t* atlasc__load_dds(sx_file_reader* reader, int64_t file_size, int* width,
+                                 int* height, atlasc__read_buffer* buff)
+{
+    uint8_t hdr[148];
+    sx_file_seekr(reader, 0, SX_WHENCE_BEGIN);
+    if (file_size < 128 || sx_file_read(reader, hdr, 128) != 128)
+        return NULL;
+
+    uint32_t flags = atlasc__read_le32(hdr + 8);
+    int h = (int)atlasc__read_le32(hdr + 12);
+    int w = (int)atlasc__read_le32(hdr + 16);
+    int pitch = (int)atlasc__read_le32(hdr + 20);
+    uint32_t pf_flags = atlasc__read_le32(hdr + 80);
+    int bpp = (int)atlasc__read_le32(hdr + 88) / 8;
+    uint32_t masks[4];
+    for (int i = 0; i < 4; i++)
+        masks[i] = atlasc__read_le32(hdr + 92 + i * 4);
+    if (!(pf_flags & 0x1))    // DDPF_ALPHAPIXELS
+        masks[3] = 0;
+
+    int offset = 128;
+    if (pf_flags & 0x4) {    // DDPF_FOURCC
+        if (atlasc__read_le32(hdr + 84) != ATLASC__DDS_DX10 ||
+            sx_file_read(reader, hdr + 128, 20) != 20) {
+            return NULL;
+        }
+        uint32_t dxgi = atlasc__read_le32(hdr + 128);
+        bool rgba = dxgi == 28 || dxgi == 29;    // R8G8B8A8_UNORM(_SRGB)
+        bool bgra = dxgi == 87 || dxgi == 91;    // B8G8R8A8_UNORM(_SRGB)
+        bool bgrx = dxgi == 88 || dxgi == 93;    // B8G8R8X8_UNORM(_SRGB)
+        if (!rgba && !bgra && !bgrx)
+            return NULL;
+        bpp = 4;
+        masks[0] = rgba ? 0x000000ff : 0x00ff0000;
+        masks[1] = 0x0000ff00;
+        masks[2] = rgba ? 0x00ff0000 : 0x000000ff;
+        masks[3] = bgrx ? 0 : 0xff000000;
+        offset += 20;
+
+        // layers of arrays without mips are stacked vertically (see atlasc__save_dds)
+        int num_layers = (int)atlasc__read_le32(hdr + 140);
+        if (num_layers > 1 && atlasc__read_le32(hdr + 28) <= 1 && h < INT_MAX / num_layers)
+            h *= num_layers;
+    } else if (!(pf_flags & 0x40) || (bpp != 3 && bpp != 4)) {    // DDPF_RGB
+        return NULL;
+    }
+
+    int shifts[4];
+    for (int i = 0; i < 4; i++) {
+        shifts[i] = 0;
+        while (shifts[i] < 32 && masks[i] && !((masks[i] >> shifts[i]) & 1))
+            shifts[i]++;
+        if (masks[i] && ((masks[i] >> shifts[i]) != 0xff || shifts[i] % 8 != 0 ||
+                         shifts[i] / 8 >= bpp)) {
+            return NULL;
+        }
+    }
+
+    int row_size = w * bpp;
+    if (!(flags & 0x8) || pitch < row_size)    // DDSD_PITCH
+        pitch = row_size;
+    if (w <= 0 || h <= 0 || (int64_t)w * h > INT_MAX / 4 ||
+        file_size < offset + (int64_t)pitch * (h - 1) + row_size) {
+        return NULL;
+    }
+    uint8_t* pixels = atlasc__malloc(w * h * 4, g_alloc_ctx);
+    if (!pixels) {
+        sx_out_of_memory();
+        return NULL;
+    }
+
+    // tightly packed 32bpp is read in place, otherwise row by row through the scratch buffer
+    bool direct = bpp == 4 && pitch == row_size;
+    uint8_t* row = direct ? NULL : atlasc__read_buffer_reserve(buff, pitch);
+    if (direct) {
+        if (sx_file_read(reader, pixels, w * h * 4) != w * h * 4) {
+            atlasc__free(pixels, g_alloc_ctx);
+            return NULL;
+        }
+    }
+
+    bool swizzle = !direct || masks[0] != 0x000000ff || masks[1] != 0x0000ff00 ||
+                   masks[2] != 0x00ff0000 || masks[3] != 0xff000000;
+    for (int y = 0; y < h && swizzle; y++) {
+        const uint8_t* src = pixels + y * row_size;
+        if (!direct) {
+            if (!row || sx_file_read(reader, row, pitch) < row_size) {
+                atlasc__free(pixels, g_alloc_ctx);
+                return NULL;
+            }
+            src = row;
+        }
+        uint8_t* dst = pixels + y * w * 4;
+        for (int x = 0; x < w; x++, src += bpp, dst += 4) {
+            uint8_t c[4];
+            for (int i = 0; i < 4; i++)
+                c[i] = masks[i] ? src[shifts[i] / 8] : (i == 3 ? 255 : 0);
+            sx_memcpy(dst, c, 4);
+        }
+    }
+
+    *width = w;
+    *height = h;
+    return pixels;
+}
+
+// returns 32bpp RGBA pixels that can be freed with `stbi_image_free`
+static uint8_t* atlasc__load_image(const char* filepath, int* width, int* height,
+                                   atlasc__read_buffer* buff)
+{
+    sx_file_reader reader;
+    if (!sx_file_open_reader(&reader, filepath))
+        return NULL;
+
+    uint8_t head[sizeof(atlasc_raw_header)] = { 0 };
+    int64_t file_size = sx_file_seekr(&reader, 0, SX_WHENCE_END);
+    sx_file_seekr(&reader, 0, SX_WHENCE_BEGIN);
+    sx_file_read(&reader, head, sizeof(head));
+
+    const char* ext = sx_strrchar(filepath, '.');
+    uint32_t magic = atlasc__read_le32(head);
+    uint8_t* pixels = NULL;
+    bool fallback = false;
+    int w = 0, h = 0;
+    if (magic == ATLASC__QOI_MAGIC) {
+        pixels = atlasc__load_qoi(&reader, file_size, width, height, buff);
+    } else if (magic == ATLASC__DDS_MAGIC) {
+        pixels = atlasc__load_dds(&reader, file_size, width, height, buff);
+    } else if (magic == ATLASC_RAW_MAGIC) {
+        const atlasc_raw_header* hdr = (const atlasc_raw_header*)head;
+        pixels = atlasc__load_raw(&reader, file_size, (int)sizeof(*hdr), (int)hdr->width,
+                                  (int)hdr->height, width, height);
+    } else if (ext && (sx_strequalnocase(ext, ".raw") || sx_strequalnocase(ext, ".rgba"))) {
+        if (atlasc__raw_size_from_name(filepath, &w, &h))
+            pixels = atlasc__load_raw(&reader, file_size, 0, w, h, width, height);
+    } else {
+        fallback = true;
+    }
+    sx_file_close_reader(&reader);
+
+    if (fallback) {
+        int comp;
+        return stbi_load(filepath, width, height, &comp, 4);
+    }
+    return pixels;
+}
+
+// fully transparent texels keep whatever color the source had, which costs compression and makes
+// sprites that only differ in invisible colors look different to --dedupe and --palettes
+static void atlasc__clear_transparent(uint32_t* pixels, int count)
+{
+    int i = 0;
+#if ATLASC__SSE2
+    const __m128i alpha_mask = _mm_set1_epi32((int)0xff000000);
+    const __m128i zero = _mm_setzero_si128();
+    for (; i + 4 <= count; i += 4) {
+        __m128i v = _mm_loadu_si128((const __m128i*)(pixels + i));
+        __m128i transparent = _mm_cmpeq_epi32(_mm_and_si128(v, alpha_mask), zero);
+        _mm_storeu_si128((__m128i*)(pixels + i), _mm_andnot_si128(transparent, v));
+    }
+#endif
+    for (; i < count; i++) {
+        if ((pixels[i] & 0xff000000) == 0)
+            pixels[i] = 0;
+    }
+}
+
+// android style nine-patch (.9.png): 1px border around the image, opaque black pixels on the top
+// and left edges mark the stretchable columns and rows. the border is stripped and the markers are
+// turned into slice insets, markers on the bottom and right edges (content area) are ignored
+static bool atlasc__is_nine_patch(const char* filepath)
+{
+    int len = sx_strlen(filepath);
+    return len > 6 && sx_strequalnocase(filepath + len - 6, ".9.png");
+}
+
+static bool atlasc__load_nine_patch(atlasc_image_data* img)
+{
+    int w = img->width, h = img->height;
+    if (w < 3 || h < 3)
+        return false;
+
+    const uint32_t* src = (const uint32_t*)img->pixels;
+    const uint32_t marker = 0xff000000;    // opaque black, RGBA in little-endian
+    int xmin = INT_MAX, xmax = INT_MIN, ymin = INT_MAX, ymax = INT_MIN;
+    for (int x = 1; x < w - 1; x++) {
+        if (src[x] == marker) {
+            xmin = sx_min(xmin, x - 1);
+            xmax = sx_max(xmax, x);
+        }
+    }
+    for (int y = 1; y < h - 1; y++) {
+        if (src[y * w] == marker) {
+            ymin = sx_min(ymin, y - 1);
+            ymax = sx_max(ymax, y);
+        }
+    }
+    if (xmin > xmax || ymin > ymax)
+        return false;
+
+    int sw = w - 2, sh = h - 2;
+    for (int y = 0; y < sh; y++)
+        sx_memmove(img->pixels + y * sw * 4, img->pixels + ((y + 1) * w + 1) * 4, sw * 4);
+    img->width = sw;
+    img->height = sh;
+    img->slice[0] = xmin;
+    img->slice[1] = ymin;
+    img->slice[2] = sw - xmax;
+    img->slice[3] = sh - ymax;
+    return true;
+}
+
+// collapses the stretchable center of a nine-slice sprite to a `strip` pixels wide band, for each
+// axis where all of its columns (rows) are the same. stretching the band at runtime gives the same
+// result as stretching the original. insets don't change, returns NULL if nothing is collapsed
+static uint8_t* atlasc__collapse_slice(const uint8_t* pixels, int w, int h, const int slice[4],
+                                       int strip, int* out_w, int* out_h)
+{
+    const uint32_t* src = (const uint32_t*)pixels;
+    int cx0 = slice[0], cx1 = w - slice[2];
+    int cy0 = slice[1], cy1 = h - slice[3];
+
+    bool collapse_x = cx1 - cx0 > strip;
+    for (int y = 0; y < h && collapse_x; y++) {
+        const uint32_t* row = src + y * w;
+        for (int x = cx0 + 1; x < cx1 && collapse_x; x++)
+            collapse_x = row[x] == row[cx0];
+    }
+
+    bool collapse_y = cy1 - cy0 > strip;
+    for (int y = cy0 + 1; y < cy1 && collapse_y; y++)
+        collapse_y = sx_memcmp(src + y * w, src + cy0 * w, w * 4) == 0;
+
+    if (!collapse_x && !collapse_y)
+        return NULL;
+
+    int skip_x = collapse_x ? (cx1 - cx0 - strip) : 0;
+    int skip_y = collapse_y ? (cy1 - cy0 - strip) : 0;
+    int nw = w - skip_x, nh = h - skip_y;
+    uint32_t* dst = atlasc__malloc(nw * nh * 4, g_alloc_ctx);
+    if (!dst) {
+        sx_out_of_memory();
+        return NULL;
+    }
+
+    int split = collapse_x ? cx0 + strip : nw;
+    for (int y = 0; y < nh; y++) {
+        const uint32_t* row = src + (y < cy0 + strip ? y : y + skip_y) * w;
+        uint32_t* drow = dst + y * nw;
+        sx_memcpy(drow, row, split * 4);
+        sx_memcpy(drow + split, row + split + skip_x, (nw - split) * 4);
+    }
+    *out_w = nw;
+    *out_h = nh;
+    return (uint8_t*)dst;
+}
+
+// writes `src` (pitch in pixels) transformed to a dw x dh image, see atlasc__transform_pt
+static void atlasc__transform_pixels(uint32_t* dst, int dw, int dh, const uint32_t* src,
+                                     int src_pitch, int transform)
+{
+    for (int y = 0; y < dh; y++) {
+        for (int x = 0; x < dw; x++) {
+            sx_ivec2 pt = atlasc__transform_pt(sx_ivec2i(x, y), dw - 1, dh - 1, transform);
+            dst[y * dw + x] = src[pt.y * src_pitch + pt.x];
+        }
+    }
+}
+
+// finds sprites that are the same as another one, mirrored and/or rotated by 90 degrees. each
+// sprite is hashed in its canonical orientation (the one with the smallest hash of all 8), so
+// candidates are found with a single lookup and only those are compared pixel by pixel.
+// `sources[i]` receives the sprite that holds the pixels of sprite i (i if it's unique) and
+// the sprite's transform is set to how it's made from those pixels
+static bool atlasc__dedupe_sprites(atlasc_sprite* sprites, int num_sprites, int* sources)
+{
+    int max_pixels = 0;
+    for (int i = 0; i < num_sprites; i++) {
+        sx_irect rc = sprites[i].sprite_rect;
+        max_pixels = sx_max(max_pixels, (rc.xmax - rc.xmin) * (rc.ymax - rc.ymin));
+    }
+
+    uint32_t* scratch = atlasc__malloc(max_pixels * 4, g_alloc_ctx);
+    sx_hashtbl* tbl = sx_hashtbl_create(g_alloc, num_sprites * 2);
+    if (!scratch || !tbl) {
+        atlasc__free(scratch, g_alloc_ctx);
+        sx_out_of_memory();
+        return false;
+    }
+
+    for (int i = 0; i < num_sprites; i++) {
+        atlasc_sprite* spr = &sprites[i];
+        int w = spr->sprite_rect.xmax - spr->sprite_rect.xmin;
+        int h = spr->sprite_rect.ymax - spr->sprite_rect.ymin;
+        int pitch = spr->src_size.x;
+        const uint32_t* pixels = (const uint32_t*)spr->src_image +
+                                 spr->sprite_rect.ymin * pitch + spr->sprite_rect.xmin;
+        sources[i] = i;
+
+        uint32_t key = UINT32_MAX;
+        for (int t = 0; t < 8; t++) {
+            int dw = (t & ATLASC_TRANSFORM_ROTATE) ? h : w;
+            int dh = (t & ATLASC_TRANSFORM_ROTATE) ? w : h;
+            atlasc__transform_pixels(scratch, dw, dh, pixels, pitch, t);
+            key = sx_min(key, sx_hash_xxh32(scratch, dw * dh * 4, ((uint32_t)dw << 16) | dh));
+        }
+        key = sx_max(key, 1u);    // zero is an empty slot in sx_hashtbl
+
+        int index = sx_hashtbl_find(tbl, key);
+        if (index == -1) {
+            sx_hashtbl_add(tbl, key, i);
+            continue;
+        }
+
+        // same canonical hash, find the transform that makes this sprite from the first one
+        const atlasc_sprite* src = &sprites[sx_hashtbl_get(tbl, index)];
+        int src_pitch = src->src_size.x;
+        const uint32_t* src_pixels = (const uint32_t*)src->src_image +
+                                     src->sprite_rect.ymin * src_pitch + src->sprite_rect.xmin;
+        int src_w = src->sprite_rect.xmax - src->sprite_rect.xmin;
+        int src_h = src->sprite_rect.ymax - src->sprite_rect.ymin;
+        for (int t = 0; t < 8; t++) {
+            bool rotate = (t & ATLASC_TRANSFORM_ROTATE) != 0;
+            if ((rotate ? src_h : src_w) != w || (rotate ? src_w : src_h) != h)
+                continue;
+
+            atlasc__transform_pixels(scratch, w, h, src_pixels, src_pitch, t);
+            bool equal = true;
+            for (int y = 0; y < h && equal; y++)
+                equal = sx_memcmp(scratch + y * w, pixels + y * pitch, w * 4) == 0;
+            if (equal) {
+                sources[i] = (int)(src - sprites);
+                spr->transform = t;
+                break;
+            }
+        }
+    }
+
+    sx_hashtbl_destroy(tbl, g_alloc);
+    atlasc__free(scratch, g_alloc_ctx);
+    return true;
+}
+
+// small open addressing color -> palette index map, holds up to 256 colors
+typedef struct atlasc__color_map {
+    uint32_t colors[512];
+    int16_t indices[512];    // -1 if the slot is empty
+} atlasc__color_map;
+
+static void atlasc__color_map_clear(atlasc__color_map* map)
+{
+    sx_memset(map->indices, 0xff, sizeof(map->indices));
+}
+
+// returns the index of `color`, adds it with `index` if it's not in the map
+static int atlasc__color_map_get(atlasc__color_map* map, uint32_t color, int index)
+{
+    uint32_t slot = (color * 2654435761u) >> 23;
+    while (map->indices[slot] >= 0 && map->colors[slot] != color)
+        slot = (slot + 1) & 511;
+    if (map->indices[slot] < 0) {
+        map->colors[slot] = color;
+        map->indices[slot] = (int16_t)index;
+    }
+    return map->indices[slot];
+}
+
+// builds the palette of a sprite and the index of each pixel in sprite_rect
+// returns false if it has more than 256 colors
+static bool atlasc__index_sprite(const atlasc_sprite* spr, atlasc__color_map* map,
+                                 atlasc_palette* palette, uint8_t* indices)
+{
+    int w = spr->sprite_rect.xmax - spr->sprite_rect.xmin;
+    int h = spr->sprite_rect.ymax - spr->sprite_rect.ymin;
+    const uint32_t* pixels = (const uint32_t*)spr->src_image +
+                             spr->sprite_rect.ymin * spr->src_size.x + spr->sprite_rect.xmin;
+
+    atlasc__color_map_clear(map);
+    palette->num_colors = 0;
+    for (int y = 0; y < h; y++) {
+        for (int x = 0; x < w; x++) {
+            uint32_t color = pixels[y * spr->src_size.x + x];
+            int index = atlasc__color_map_get(map, color, palette->num_colors);
+            if (index == palette->num_colors) {
+                if (index == 256)
+                    return false;
+                palette->colors[palette->num_colors++] = color;
+            }
+            indices[y * w + x] = (uint8_t)index;
+        }
+    }
+    return true;
+}
+
+// finds sprites that are recolors of another one: same size and alpha mask, and their colors map
+// one-to-one to the colors of the other sprite. the first sprite of each such group keeps its
+// place in the atlas and stores palette indices instead of colors, recolors become duplicates of
+// it (see `sources`). every sprite of a group gets its own palette.
+// `index_maps[i]` receives the palette indices of group sprites that are packed
+static bool atlasc__find_palettes(atlasc_sprite* sprites, int num_sprites, int* sources,
+                                  uint8_t** index_maps, atlasc_palette** palettes)
+{
+    int max_pixels = 0;
+    for (int i = 0; i < num_sprites; i++) {
+        sx_irect rc = sprites[i].sprite_rect;
+        max_pixels = sx_max(max_pixels, (rc.xmax - rc.xmin) * (rc.ymax - rc.ymin));
+    }
+
+    uint8_t* scratch = atlasc__malloc(max_pixels, g_alloc_ctx);
+    atlasc__color_map* map = atlasc__malloc(sizeof(atlasc__color_map), g_alloc_ctx);
+    atlasc_palette* palette = atlasc__malloc(sizeof(atlasc_palette), g_alloc_ctx);
+    sx_hashtbl* tbl = sx_hashtbl_create(g_alloc, num_sprites * 2);
+    bool r = scratch && map && palette && tbl;
+    if (!r) {
+        sx_out_of_memory();
+        goto cleanup;
+    }
+
+    for (int i = 0; i < num_sprites && r; i++) {
+        atlasc_sprite* spr = &sprites[i];
+        if (sources[i] != i)
+            continue;
+
+        int w = spr->sprite_rect.xmax - spr->sprite_rect.xmin;
+        int h = spr->sprite_rect.ymax - spr->sprite_rect.ymin;
+        const uint32_t* pixels = (const uint32_t*)spr->src_image +
+                                 spr->sprite_rect.ymin * spr->src_size.x + spr->sprite_rect.xmin;
+        for (int y = 0; y < h; y++) {
+            for (int x = 0; x < w; x++)
+                scratch[y * w + x] = (uint8_t)(pixels[y * spr->src_size.x + x] >> 24);
+        }
+        uint32_t key = sx_max(sx_hash_xxh32(scratch, w * h, ((uint32_t)w << 16) | h), 1u);
+
+        int index = sx_hashtbl_find(tbl, key);
+        if (index == -1) {
+            sx_hashtbl_add(tbl, key, i);
+            continue;
+        }
+
+        int base_idx = sx_hashtbl_get(tbl, index);
+        atlasc_sprite* base = &sprites[base_idx];
+        if (base->sprite_rect.xmax - base->sprite_rect.xmin != w ||
+            base->sprite_rect.ymax - base->sprite_rect.ymin != h || base->palette == -2) {
+            continue;
+        }
+
+        // index the first sprite of the group when it gets its first recolor
+        if (!index_maps[base_idx]) {
+            index_maps[base_idx] = atlasc__malloc(w * h, g_alloc_ctx);
+            if (!index_maps[base_idx]) {
+                sx_out_of_memory();
+                r = false;
+                break;
+            }
+            if (!atlasc__index_sprite(base, map, palette, index_maps[base_idx])) {
+                atlasc__free(index_maps[base_idx], g_alloc_ctx);
+                index_maps[base_idx] = NULL;
+                base->palette = -2;    // too many colors, don't try again
+                continue;
+            }
+            base->palette = sx_array_count(*palettes);
+            sx_array_push(g_alloc, *palettes, *palette);
+        }
+
+        // the mapping must be one-to-one: each index gets a single color and each color is used
+        // by a single index
+        const uint8_t* indices = index_maps[base_idx];
+        bool used[256] = { 0 };
+        atlasc__color_map_clear(map);
+        palette->num_colors = (*palettes)[base->palette].num_colors;
+        bool recolor = true;
+        for (int y = 0; y < h && recolor; y++) {
+            for (int x = 0; x < w && recolor; x++) {
+                uint32_t color = pixels[y * spr->src_size.x + x];
+                int k = indices[y * w + x];
+                recolor = atlasc__color_map_get(map, color, k) == k &&
+                          (!used[k] || palette->colors[k] == color);
+                palette->colors[k] = color;
+                used[k] = true;
+            }
+        }
+
+        if (recolor) {
+            sources[i] = base_idx;
+            spr->palette = sx_array_count(*palettes);
+            sx_array_push(g_alloc, *palettes, *palette);
+        }
+    }
+
+    // duplicates (--dedupe) of recolors point to the first sprite of the group
+    for (int i = 0; i < num_sprites; i++) {
+        if (sources[i] != i && sprites[i].palette == -1) {
+            sprites[i].palette = sprites[sources[i]].palette;
+            sources[i] = sources[sources[i]];
+        }
+        if (sprites[i].palette == -2)
+            sprites[i].palette = -1;
+    }
+
+cleanup:
+    if (tbl)
+        sx_hashtbl_destroy(tbl, g_alloc);
+    atlasc__free(palette, g_alloc_ctx);
+    atlasc__free(map, g_alloc_ctx);
+    atlasc__free(scratch, g_alloc_ctx);
+    return r;
+}
+
+// sprite analysis (trimmed rect and mesh) only depends on the thresholded alpha mask, so sprites
+// with the same mask (recolored, relit or tinted variants) reuse the results of the first one.
+// with `cache_dir`, results are also kept on disk for next builds, one file per mask hash.
+// many builds can share the directory: files are sharded by the first byte of the hash
+// (<cache_dir>/ab/cdef0123456789.bin), written once to a temp file and renamed in place, so
+// readers never lock and only see complete files. a file that is gone is just a miss
+#define ATLASC__CACHE_MAGIC 0x4d434c41    // 'ALCM'
+#define ATLASC__CACHE_VERSION 2
+#define ATLASC__CACHE_TEMP_AGE 3600    // seconds, older temp files are left by killed builds
+#define ATLASC__CACHE_SCAN_AGE 600     // seconds, the tracked size is trusted for this long
+#define ATLASC__CACHE_SIZE_FILE "size"
+
+typedef struct atlasc__analysis {
+    uint64_t key;
+    int width;
+    int height;
+    uint8_t* mask;    // to rule out hash collisions within a build, NULL for cached results
+    sx_irect rect;
+    int num_points;
+    int num_tris;
+    sx_ivec2* pts;
+    uint16_t* tris;
+    int num_outline;
+    sx_ivec2* outline;    // simplified outline, for colliders
+} atlasc__analysis;
+
+typedef struct atlasc__cache_header {
+    uint32_t magic;
+    uint32_t version;
+    uint64_t key;
+    int32_t rect[4];
+    int32_t num_points;     // followed by int32_t pts[num_points*2]
+    int32_t num_outline;    // followed by int32_t outline[num_outline*2]
+    int32_t num_tris;       // followed by uint16_t tris[num_tris*3]
+} atlasc__cache_header;
+
+typedef struct atlasc__memo {
+    sx_hashtbl* tbl;    // folded key -> entry
+    atlasc__analysis* entries;
+    const char* cache_dir;
+    int64_t bytes_written;    // to the cache
+} atlasc__memo;
+
+// size of the cache directory, kept in <cache_dir>/size so that builds don't have to stat every
+// file. builds add what they write, concurrent builds may lose each other's updates and files are
+// rewritten, so it's an estimate that is corrected by a full scan every ATLASC__CACHE_SCAN_AGE
+typedef struct atlasc__cache_size {
+    int64_t bytes;
+    uint64_t scan_time;
+} atlasc__cache_size;
+
+static bool atlasc__memo_init(atlasc__memo* memo, int num_sprites, const char* cache_dir)
+{
+    sx_memset(memo, 0x0, sizeof(*memo));
+    memo->tbl = sx_hashtbl_create(g_alloc, num_sprites * 2);
+    memo->cache_dir = cache_dir;
+    if (cache_dir && !sx_os_path_isdir(cache_dir))
+        sx_os_mkdir(cache_dir);
+    return memo->tbl != NULL;
+}
+
+static void atlasc__memo_release(atlasc__memo* memo)
+{
+    for (int i = 0, c = sx_array_count(memo->entries); i < c; i++) {
+        atlasc__free(memo->entries[i].mask, g_alloc_ctx);
+        atlasc__free(memo->entries[i].pts, g_alloc_ctx);
+        atlasc__free(memo->entries[i].tris, g_alloc_ctx);
+        atlasc__free(memo->entries[i].outline, g_alloc_ctx);
+    }
+    sx_array_free(g_alloc, memo->entries);
+    if (memo->tbl)
+        sx_hashtbl_destroy(memo->tbl, g_alloc);
+    sx_memset(memo, 0x0, sizeof(*memo));
+}
+
+// mask hash, mixed with the arguments that change the results
+static uint64_t atlasc__mask_key(const uint8_t* mask, int w, int h, const atlasc_args* args)
+{
+    const int params[] = { w,
+                           h,
+                           args->mesh,
+                           args->colliders != 0,
+                           args->mesh || args->colliders ? args->max_verts_per_mesh : 0,
+                           ATLASC__CACHE_VERSION };
+    return sx_hash_xxh64(mask, (size_t)w * h, sx_hash_xxh64(params, sizeof(params), 0));
+}
+
+static void atlasc__cache_shard_dir(char* dirpath, int size, const char* cache_dir, int shard)
+{
+    char name[4];
+    sx_snprintf(name, sizeof(name), "%02x", shard);
+    sx_os_path_join(dirpath, size, cache_dir, name);
+}
+
+static void atlasc__cache_filepath(char* filepath, int size, const char* cache_dir, uint64_t key)
+{
+    char dirpath[256];
+    char filename[32];
+    atlasc__cache_shard_dir(dirpath, sizeof(dirpath), cache_dir, (int)(key >> 56));
+    sx_snprintf(filename, sizeof(filename), "%014llx.bin",
+                (unsigned long long)(key & 0xffffffffffffffull));
+    sx_os_path_join(filepath, size, dirpath, filename);
+}
+
+// cache files can be truncated or corrupt, anything that doesn't fit the sprite is a miss
+static bool atlasc__cache_entry_valid(const atlasc__analysis* entry)
+{
+    int w = entry->width, h = entry->height;
+    sx_irect rc = entry->rect;
+    if (rc.xmin < 0 || rc.ymin < 0 || rc.xmin > rc.xmax || rc.ymin > rc.ymax || rc.xmax > w ||
+        rc.ymax > h) {
+        return false;
+    }
+    if (entry->num_points >= UINT16_MAX || entry->num_tris > UINT16_MAX ||
+        (entry->num_points == 0 && entry->num_tris != 0)) {
+        return false;
+    }
+    for (int i = 0; i < entry->num_points; i++) {
+        sx_ivec2 pt = entry->pts[i];
+        if (pt.x < 0 || pt.y < 0 || pt.x > w || pt.y > h)
+            return false;
+    }
+    for (int i = 0, c = entry->num_tris * 3; i < c; i++) {
+        if (entry->tris[i] >= entry->num_points)
+            return false;
+    }
+    for (int i = 0; i < entry->num_outline; i++) {
+        sx_ivec2 pt = entry->outline[i];
+        if (pt.x < 0 || pt.y < 0 || pt.x > w || pt.y > h)
+            return false;
+    }
+    return true;
+}
+
+static bool atlasc__cache_load(const char* cache_dir, uint64_t key, atlasc__analysis* entry)
+{
+    char filepath[256];
+    atlasc__cache_filepath(filepath, sizeof(filepath), cache_dir, key);
+    if (!sx_os_path_isfile(filepath))
+        return false;
+    sx_mem_block* block = sx_file_load_bin(g_alloc, filepath);
+    if (!block)
+        return false;
+
+    const atlasc__cache_header* hdr = (const atlasc__cache_header*)block->data;
+    bool r = block->size >= (int64_t)sizeof(*hdr) && hdr->magic == ATLASC__CACHE_MAGIC &&
+             hdr->version == ATLASC__CACHE_VERSION && hdr->key == key && hdr->num_points >= 0 &&
+             hdr->num_outline >= 0 && hdr->num_tris >= 0 &&
+             block->size == (int64_t)sizeof(*hdr) +
+                                (int64_t)sizeof(int32_t) * 2 *
+                                    ((int64_t)hdr->num_points + hdr->num_outline) +
+                                (int64_t)sizeof(uint16_t) * 3 * hdr->num_tris;
+    if (r) {
+        entry->rect = sx_irecti(hdr->rect[0], hdr->rect[1], hdr->rect[2], hdr->rect[3]);
+        entry->num_points = hdr->num_points;
+        entry->num_tris = hdr->num_tris;
+        if (hdr->num_points) {
+            entry->pts = atlasc__malloc(sizeof(sx_ivec2) * hdr->num_points, g_alloc_ctx);
+            entry->tris = atlasc__malloc(sizeof(uint16_t) * 3 * hdr->num_tris, g_alloc_ctx);
+            r = entry->pts && entry->tris;
+            if (r) {
+                const int32_t* pts = (const int32_t*)(hdr + 1);
+                for (int i = 0; i < hdr->num_points; i++)
+                    entry->pts[i] = sx_ivec2i(pts[i * 2], pts[i * 2 + 1]);
+                sx_memcpy(entry->tris, pts + (hdr->num_points + hdr->num_outline) * 2,
+                          sizeof(uint16_t) * 3 * hdr->num_tris);
+            }
+        }
+        if (r && hdr->num_outline) {
+            const int32_t* pts = (const int32_t*)(hdr + 1) + hdr->num_points * 2;
+            entry->num_outline = hdr->num_outline;
+            entry->outline = atlasc__malloc(sizeof(sx_ivec2) * hdr->num_outline, g_alloc_ctx);
+            r = entry->outline != NULL;
+            for (int i = 0; r && i < hdr->num_outline; i++)
+                entry->outline[i] = sx_ivec2i(pts[i * 2], pts[i * 2 + 1]);
+        }
+        r = r && atlasc__cache_entry_valid(entry);
+    }
+    sx_mem_destroy_block(block);
+
+    // the gc removes the least recently used files first
+    if (r)
+        atlasc__touch(filepath);
+    return r;
+}
+
+// written to a temp file first, so concurrent builds never read a partial file. returns the bytes
+// that are written
+static int64_t atlasc__cache_save(const char* cache_dir, const atlasc__analysis* entry)
+{
+    static int counter = 0;
+    char dirpath[256];
+    char filepath[256];
+    char temp_filepath[256];
+    atlasc__cache_shard_dir(dirpath, sizeof(dirpath), cache_dir, (int)(entry->key >> 56));
+    if (!sx_os_path_isdir(dirpath))
+        sx_os_mkdir(dirpath);    // fails if another build made it first
+    atlasc__cache_filepath(filepath, sizeof(filepath), cache_dir, entry->key);
+
+    atlasc__cache_header hdr = { .magic = ATLASC__CACHE_MAGIC,
+                                 .version = ATLASC__CACHE_VERSION,
+                                 .key = entry->key,
+                                 .rect = { entry->rect.xmin, entry->rect.ymin, entry->rect.xmax,
+                                           entry->rect.ymax },
+                                 .num_points = entry->num_points,
+                                 .num_outline = entry->num_outline,
+                                 .num_tris = entry->num_tris };
+    sx_snprintf(temp_filepath, sizeof(temp_filepath), "%s.%d-%d.tmp", filepath,
+                (int)atlasc__getpid(), counter++);
+    sx_file_writer writer;
+    if (!sx_file_open_writer(&writer, temp_filepath, 0))
+        return 0;
+    sx_file_write_var(&writer, hdr);
+    for (int i = 0; i < entry->num_points; i++) {
+        int32_t pt[2] = { entry->pts[i].x, entry->pts[i].y };
+        sx_file_write(&writer, pt, sizeof(pt));
+    }
+    for (int i = 0; i < entry->num_outline; i++) {
+        int32_t pt[2] = { entry->outline[i].x, entry->outline[i].y };
+        sx_file_write(&writer, pt, sizeof(pt));
+    }
+    sx_file_write(&writer, entry->tris, (int)sizeof(uint16_t) * 3 * entry->num_tris);
+    sx_file_close_writer(&writer);
+    if (!sx_os_rename(temp_filepath, filepath)) {
+        sx_os_del(temp_filepath, SX_FILE_TYPE_REGULAR);
+        return 0;
+    }
+    return (int64_t)sizeof(hdr) +
+           (int64_t)sizeof(int32_t) * 2 * ((int64_t)entry->num_points + entry->num_outline) +
+           (int64_t)sizeof(uint16_t) * 3 * entry->num_tris;
+}
+
+static bool atlasc__cache_size_load(const char* cache_dir, atlasc__cache_size* size)
+{
+    char filepath[256];
+    sx_os_path_join(filepath, sizeof(filepath), cache_dir, ATLASC__CACHE_SIZE_FILE);
+    if (!sx_os_path_isfile(filepath))
+        return false;
+    sx_mem_block* block = sx_file_load_bin(g_alloc, filepath);
+    if (!block)
+        return false;
+    bool r = block->size == (int64_t)sizeof(*size);
+    if (r)
+        sx_memcpy(size, block->data, sizeof(*size));
+    sx_mem_destroy_block(block);
+    return r && size->bytes >= 0;
+}
+
+static void atlasc__cache_size_save(const char* cache_dir, const atlasc__cache_size* size)
+{
+    char filepath[256];
+    char temp_filepath[280];
+    sx_os_path_join(filepath, sizeof(filepath), cache_dir, ATLASC__CACHE_SIZE_FILE);
+    sx_snprintf(temp_filepath, sizeof(temp_filepath), "%s.%d.tmp", filepath,
+                (int)atlasc__getpid());
+    sx_file_writer writer;
+    if (!sx_file_open_writer(&writer, temp_filepath, 0))
+        return;
+    sx_file_write(&writer, size, sizeof(*size));
+    sx_file_close_writer(&writer);
+    if (!sx_os_rename(temp_filepath, filepath))
+        sx_os_del(temp_filepath, SX_FILE_TYPE_REGULAR);
+}
+
+// files of the flat layout before the cache was sharded: <cache_dir>/<16 hex digits>.bin
+static bool atlasc__cache_is_legacy(const char* name)
+{
+    if (sx_strlen(name) != 20 || !sx_strequal(name + 16, ".bin"))
+        return false;
+    for (int i = 0; i < 16; i++) {
+        char c = name[i];
+        if (!((c >= '0' && c <= '9') || (c >= 'a' && c <= 'f')))
+            return false;
+    }
+    return true;
+}
+
+typedef struct atlasc__cache_file {
+    char name[48];
+    int shard;    // -1 for the cache root
+    uint64_t size;
+    uint64_t last_modified;
+} atlasc__cache_file;
+
+typedef void(atlasc__list_cb)(const char* name, void* user);
+
+// calls `fn` for the files in a directory
+static void atlasc__list_dir(const char* dirpath, atlasc__list_cb* fn, void* user)
+{
+#if SX_PLATFORM_WINDOWS
+    char pattern[256];
+    struct _finddata_t data;
+    sx_os_path_join(pattern, sizeof(pattern), dirpath, "*");
+    intptr_t handle = _findfirst(pattern, &data);
+    if (handle == -1)
+        return;
+    do {
+        if (!(data.attrib & _A_SUBDIR))
+            fn(data.name, user);
+    } while (_findnext(handle, &data) == 0);
+    _findclose(handle);
+#else
+    DIR* dir = opendir(dirpath);
+    if (!dir)
+        return;
+    struct dirent* ent;
+    while ((ent = readdir(dir)) != NULL) {
+        if (ent->d_name[0] != '.')
+            fn(ent->d_name, user);
+    }
+    closedir(dir);
+#endif
+}
+
+typedef struct atlasc__cache_gc_list {
+    atlasc__cache_file* files;
+    int shard;
+} atlasc__cache_gc_list;
+
+static void atlasc__cache_gc_add(const char* name, void* user)
+{
+    atlasc__cache_gc_list* list = user;
+    atlasc__cache_file file = { .shard = list->shard };
+    if (sx_strlen(name) < (int)sizeof(file.name)) {
+        sx_strcpy(file.name, sizeof(file.name), name);
+        sx_array_push(g_alloc, list->files, file);
+    }
+}
+
+static int atlasc__cache_file_cmp(const void* a, const void* b)
+{
+    const atlasc__cache_file* fa = a;
+    const atlasc__cache_file* fb = b;
+    if (fa->last_modified != fb->last_modified)
+        return fa->last_modified < fb->last_modified ? -1 : 1;
+    return fa->shard != fb->shard ? fa->shard - fb->shard : strcmp(fa->name, fb->name);
+}
+
+static void atlasc__cache_gc_filepath(char* filepath, int size, const char* cache_dir,
+                                      const atlasc__cache_file* file)
+{
+    char dirpath[256];
+    if (file->shard >= 0) {
+        atlasc__cache_shard_dir(dirpath, sizeof(dirpath), cache_dir, file->shard);
+        sx_os_path_join(filepath, size, dirpath, file->name);
+    } else {
+        sx_os_path_join(filepath, size, cache_dir, file->name);
+    }
+}
+
+// removes the least recently used cache files until the directory is within `limit` bytes, and
+// temp and legacy files that were left behind. the directory is only scanned when the tracked size
+// is over the limit or stale. it's safe while other builds use the directory: their reads of
+// removed files are misses and their writes are renamed in place whatever happens to older files
+static void atlasc__cache_gc(const char* cache_dir, int64_t limit, int64_t bytes_written)
+{
+    char dirpath[256];
+    char filepath[256];
+    uint64_t now = (uint64_t)time(NULL);
+
+    atlasc__cache_size size;
+    if (atlasc__cache_size_load(cache_dir, &size) && now >= size.scan_time &&
+        now - size.scan_time < ATLASC__CACHE_SCAN_AGE) {
+        size.bytes += bytes_written;
+        if (size.bytes <= limit) {
+            if (bytes_written > 0)
+                atlasc__cache_size_save(cache_dir, &size);
+            return;
+        }
+    }
+
+    atlasc__cache_gc_list list = { .shard = -1 };
+    atlasc__list_dir(cache_dir, atlasc__cache_gc_add, &list);
+    for (int shard = 0; shard < 256; shard++) {
+        atlasc__cache_shard_dir(dirpath, sizeof(dirpath), cache_dir, shard);
+        list.shard = shard;
+        atlasc__list_dir(dirpath, atlasc__cache_gc_add, &list);
+    }
+
+    int64_t total = 0;
+    int num_files = 0;
+    for (int i = 0, c = sx_array_count(list.files); i < c; i++) {
+        atlasc__cache_file* file = &list.files[i];
+        atlasc__cache_gc_filepath(filepath, sizeof(filepath), cache_dir, file);
+        sx_file_info info = sx_os_stat(filepath);
+        if (info.type != SX_FILE_TYPE_REGULAR)
+            continue;
+
+        const char* ext = sx_strrchar(file->name, '.');
+        if (ext && sx_strequal(ext, ".tmp")) {
+            if (now > info.last_modified && now - info.last_modified > ATLASC__CACHE_TEMP_AGE)
+                sx_os_del(filepath, SX_FILE_TYPE_REGULAR);
+            continue;
+        }
+        if (file->shard < 0) {
+            // no longer read, the size file is the only one the root should have
+            if (atlasc__cache_is_legacy(file->name))
+                sx_os_del(filepath, SX_FILE_TYPE_REGULAR);
+            continue;
+        }
+
+        file->size = info.size;
+        file->last_modified = info.last_modified;
+        total += (int64_t)info.size;
+        list.files[num_files++] = *file;
+    }
+
+    if (total > limit) {
+        qsort(list.files, num_files, sizeof(atlasc__cache_file), atlasc__cache_file_cmp);
+        for (int i = 0; i < num_files && total > limit; i++) {
+            atlasc__cache_gc_filepath(filepath, sizeof(filepath), cache_dir, &list.files[i]);
+            sx_os_del(filepath, SX_FILE_TYPE_REGULAR);
+            total -= (int64_t)list.files[i].size;
+        }
+    }
+    sx_array_free(g_alloc, list.files);
+
+    size = (atlasc__cache_size){ .bytes = total, .scan_time = now };
+    atlasc__cache_size_save(cache_dir, &size);
+}
+
+// returns the analysis of the same mask, from this build or the cache. NULL if there is none
+static const atlasc__analysis* atlasc__memo_find(atlasc__memo* memo, uint64_t key,
+                                                 const uint8_t* mask, int w, int h)
+{
+    int index = sx_hashtbl_find(memo->tbl, sx_max(sx_hash_u64_to_u32(key), 1u));
+    if (index != -1) {
+        const atlasc__analysis* entry = &memo->entries[sx_hashtbl_get(memo->tbl, index)];
+        if (entry->key == key && entry->width == w && entry->height == h &&
+            (!entry->mask || sx_memcmp(entry->mask, mask, (size_t)w * h) == 0)) {
+            return entry;
+        }
+        return NULL;
+    }
+
+    atlasc__analysis entry = { .key = key, .width = w, .height = h };
+    if (memo->cache_dir && atlasc__cache_load(memo->cache_dir, key, &entry)) {
+        sx_hashtbl_add(memo->tbl, sx_max(sx_hash_u64_to_u32(key), 1u),
+                       sx_array_count(memo->entries));
+        sx_array_push(g_alloc, memo->entries, entry);
+        return &memo->entries[sx_array_count(memo->entries) - 1];
+    }
+    atlasc__free(entry.pts, g_alloc_ctx);
+    atlasc__free(entry.tris, g_alloc_ctx);
+    atlasc__free(entry.outline, g_alloc_ctx);
+    return NULL;
+}
+
+// keeps the results of an analyzed sprite, takes ownership of `mask`
+static void atlasc__memo_add(atlasc__memo* memo, uint64_t key, uint8_t* mask,
+                             const atlasc_sprite* spr)
+{
+    uint32_t folded = sx_max(sx_hash_u64_to_u32(key), 1u);
+    atlasc__analysis entry = { .key = key,
+                               .width = spr->src_size.x,
+                               .height = spr->src_size.y,
+                               .mask = mask,
+                               .rect = spr->sprite_rect,
+                               .num_points = spr->num_points,
+                               .num_tris = spr->num_tris };
+    if (spr->pts) {
+        entry.pts = atlasc__malloc(sizeof(sx_ivec2) * spr->num_points, g_alloc_ctx);
+        entry.tris = atlasc__malloc(sizeof(uint16_t) * 3 * spr->num_tris, g_alloc_ctx);
+        if (!entry.pts || !entry.tris) {
+            atlasc__free(entry.pts, g_alloc_ctx);
+            atlasc__free(entry.tris, g_alloc_ctx);
+            atlasc__free(mask, g_alloc_ctx);
+            return;
+        }
+        sx_memcpy(entry.pts, spr->pts, sizeof(sx_ivec2) * spr->num_points);
+        sx_memcpy(entry.tris, spr->tris, sizeof(uint16_t) * 3 * spr->num_tris);
+    }
+    if (spr->collider_pts) {
+        entry.num_outline = spr->num_collider_pts;
+        entry.outline = atlasc__malloc(sizeof(sx_ivec2) * spr->num_collider_pts, g_alloc_ctx);
+        if (!entry.outline) {
+            atlasc__free(entry.pts, g_alloc_ctx);
+            atlasc__free(entry.tris, g_alloc_ctx);
+            atlasc__free(mask, g_alloc_ctx);
+            return;
+        }
+        sx_memcpy(entry.outline, spr->collider_pts, sizeof(sx_ivec2) * spr->num_collider_pts);
+    }
+
+    if (memo->cache_dir)
+        memo->bytes_written += atlasc__cache_save(memo->cache_dir, &entry);
+    if (sx_hashtbl_find(memo->tbl, folded) == -1)
+        sx_hashtbl_add(memo->tbl, folded, sx_array_count(memo->entries));
+    sx_array_push(g_alloc, memo->entries, entry);
+}
+
+static bool atlasc__memo_apply(const atlasc__analysis* entry, atlasc_sprite* spr)
+{
+    spr->sprite_rect = entry->rect;
+    if (entry->pts) {
+        spr->pts = atlasc__malloc(sizeof(sx_ivec2) * entry->num_points, g_alloc_ctx);
+        spr->tris = atlasc__malloc(sizeof(uint16_t) * 3 * entry->num_tris, g_alloc_ctx);
+        if (!spr->pts || !spr->tris) {
+            sx_out_of_memory();
+            return false;
+        }
+        sx_memcpy(spr->pts, entry->pts, sizeof(sx_ivec2) * entry->num_points);
+        sx_memcpy(spr->tris, entry->tris, sizeof(uint16_t) * 3 * entry->num_tris);
+        spr->num_points = entry->num_points;
+        spr->num_tris = (uint16_t)entry->num_tris;
+    }
+    if (entry->outline) {
+        spr->collider_pts = atlasc__malloc(sizeof(sx_ivec2) * entry->num_outline, g_alloc_ctx);
+        if (!spr->collider_pts) {
+            sx_out_of_memory();
+            return false;
+        }
+        sx_memcpy(spr->collider_pts, entry->outline, sizeof(sx_ivec2) * entry->num_outline);
+        spr->num_collider_pts = entry->num_outline;
+    }
+    return true;
+}
+
+// packs the thresholded mask within sprite_rect into 1bit cells of `cell` x `cell` pixels, a cell
+// is set if any of its pixels is. rows start on byte boundaries (see atlasc_sprite.hit_mask)
+static bool atlasc__make_hit_mask(atlasc_sprite* spr, const uint8_t* thresholded, int cell)
+{
+    int w = spr->sprite_rect.xmax - spr->sprite_rect.xmin;
+    int h = spr->sprite_rect.ymax - spr->sprite_rect.ymin;
+    if (w <= 0 || h <= 0)
+        return true;
+
+    int pitch = ((w + cell - 1) / cell + 7) >> 3;
+    int size = pitch * ((h + cell - 1) / cell);
+    uint8_t* mask = atlasc__malloc(size, g_alloc_ctx);
+    if (!mask) {
+        sx_out_of_memory();
+        return false;
+    }
+    sx_memset(mask, 0x0, size);
+
+    for (int y = 0; y < h; y++) {
+        const uint8_t* src =
+            thresholded + (spr->sprite_rect.ymin + y) * spr->src_size.x + spr->sprite_rect.xmin;
+        uint8_t* dst = mask + (y / cell) * pitch;
+        for (int x = 0; x < w; x++) {
+            int cx = x / cell;
+            dst[cx >> 3] |= (src[x] ? 1 : 0) << (cx & 7);
+        }
+    }
+
+    spr->hit_mask = mask;
+    return true;
+}
+
+static inline int atlasc__popcount64(uint64_t v)
+{
+    v = v - ((v >> 1) & 0x5555555555555555ull);
+    v = (v & 0x3333333333333333ull) + ((v >> 2) & 0x3333333333333333ull);
+    v = (v + (v >> 4)) & 0x0f0f0f0f0f0f0f0full;
+    return (int)((v * 0x0101010101010101ull) >> 56);
+}
+
+// sets bits [x0, x1) of a row
+static inline void atlasc__fill_bits(uint64_t* row, int x0, int x1)
+{
+    int w0 = x0 >> 6;
+    int w1 = (x1 - 1) >> 6;
+    uint64_t m0 = ~0ull << (x0 & 63);
+    uint64_t m1 = ~0ull >> (63 - ((x1 - 1) & 63));
+    if (w0 == w1) {
+        row[w0] |= m0 & m1;
+    } else {
+        row[w0] |= m0;
+        for (int k = w0 + 1; k < w1; k++)
+            row[k] = ~0ull;
+        row[w1] |= m1;
+    }
+}
+
+// conservative rasterization of the mesh into a bit mask: a pixel is set if any triangle overlaps
+// it. each row is the x extent of the triangle clipped to the row. the result is compared with
+// the thresholded mask 64 pixels at a time
+static bool atlasc__check_mesh(atlasc_sprite* spr, const uint8_t* thresholded)
+{
+    int w = spr->src_size.x;
+    int h = spr->src_size.y;
+    int pitch = (w + 63) >> 6;
+    uint64_t* covered = atlasc__malloc(sizeof(uint64_t) * pitch * h * 2, g_alloc_ctx);
+    if (!covered) {
+        sx_out_of_memory();
+        return false;
+    }
+    uint64_t* opaque = covered + pitch * h;
+    sx_memset(covered, 0x0, sizeof(uint64_t) * pitch * h * 2);
+
+    for (int y = 0; y < h; y++) {
+        for (int x = 0; x < w; x++) {
+            if (thresholded[y * w + x])
+                opaque[y * pitch + (x >> 6)] |= 1ull << (x & 63);
+        }
+    }
+
+    for (int i = 0, c = (int)spr->num_tris * 3; i < c; i += 3) {
+        sx_ivec2 v[3] = { spr->pts[spr->tris[i]], spr->pts[spr->tris[i + 1]],
+                          spr->pts[spr->tris[i + 2]] };
+        int ymin = sx_max(0, sx_min(sx_min(v[0].y, v[1].y), v[2].y));
+        int ymax = sx_min(h, sx_max(sx_max(v[0].y, v[1].y), v[2].y));
+        for (int y = ymin; y < ymax; y++) {
+            float xmin = SX_FLOAT_MAX;
+            float xmax = -SX_FLOAT_MAX;
+            for (int e = 0; e < 3; e++) {
+                sx_ivec2 p = v[e];
+                sx_ivec2 q = v[(e + 1) % 3];
+                int ey0 = sx_max(sx_min(p.y, q.y), y);
+                int ey1 = sx_min(sx_max(p.y, q.y), y + 1);
+                if (ey0 > ey1)
+                    continue;
+                float x0 = (float)p.x;
+                float x1 = (float)q.x;
+                if (p.y != q.y) {
+                    float dx = (float)(q.x - p.x) / (float)(q.y - p.y);
+                    x0 = (float)p.x + dx * (float)(ey0 - p.y);
+                    x1 = (float)p.x + dx * (float)(ey1 - p.y);
+                }
+                xmin = sx_min(xmin, sx_min(x0, x1));
+                xmax = sx_max(xmax, sx_max(x0, x1));
+            }
+            int x0 = sx_max(0, (int)sx_floor(xmin));
+            int x1 = sx_min(w, (int)sx_ceil(xmax));
+            if (x1 > x0)
+                atlasc__fill_bits(&covered[y * pitch], x0, x1);
+        }
+    }
+
+    int num_uncovered = 0;
+    int num_covered = 0;
+    int num_opaque = 0;
+    for (int i = 0, c = pitch * h; i < c; i++) {
+        num_uncovered += atlasc__popcount64(opaque[i] & ~covered[i]);
+        num_covered += atlasc__popcount64(covered[i]);
+        num_opaque += atlasc__popcount64(opaque[i]);
+    }
+    spr->mesh_uncovered = num_uncovered;
+    spr->mesh_overdraw = num_opaque ? (float)num_covered / (float)num_opaque : 0;
+
+    atlasc__free(covered, g_alloc_ctx);
+    return true;
+}
+
+// d3d11 limit of texture array size
+#define ATLASC__MAX_LAYERS 2048
+
+// packs rects into pages of max_width x max_height (a single page unless `array` is set), rects
+// that don't fit are moved to the front and packed into the next page. results are written to
+// `packed[id]` and `layers[id]`, the size of the largest page to `size`.
+// returns the number of pages, 0 if a rect doesn't fit (rects[0] is the first one that failed)
+// and -1 if they need more than ATLASC__MAX_LAYERS pages
+static int atlasc__pack_pages(const atlasc_args* cargs, stbrp_rect* rects, int num_rects,
+                              stbrp_node* nodes, stbrp_rect* packed, int* layers, sx_ivec2* size)
+{
+    stbrp_context rp_ctx;
+    sx_irect final_rect = sx_irecti(INT_MAX, INT_MAX, INT_MIN, INT_MIN);
+    int num_layers = 0;
+    int num_pending = num_rects;
+    while (num_pending > 0) {
+        stbrp_init_target(&rp_ctx, cargs->max_width, cargs->max_height, nodes,
+                          cargs->max_width + cargs->max_height);
+        bool all_packed = stbrp_pack_rects(&rp_ctx, rects, num_pending) != 0;
+        int num_left = 0;
+        for (int i = 0; i < num_pending; i++) {
+            const stbrp_rect* rc = &rects[i];
+            if (!rc->was_packed) {
+                rects[num_left++] = *rc;
+                continue;
+            }
+            packed[rc->id] = *rc;
+            layers[rc->id] = num_layers;
+
+            // calculate the total size of output image
+            sx_irect_add_point(&final_rect, sx_ivec2i(rc->x, rc->y));
+            sx_irect_add_point(&final_rect, sx_ivec2i(rc->x + rc->w, rc->y + rc->h));
+        }
+        num_layers++;
+
+        if (num_left == num_pending || (!all_packed && !cargs->array))
+            return 0;
+        if (num_left > 0 && num_layers == ATLASC__MAX_LAYERS)
+            return -1;
+        num_pending = num_left;
+    }
+
+    int w = final_rect.xmax - final_rect.xmin;
+    int h = final_rect.ymax - final_rect.ymin;
+    // make output size divide by 4 by default
+    w = sx_align_mask(w, 3);
+    h = sx_align_mask(h, 3);
+
+    if (cargs->pot) {
+        w = sx_nearest_pow2(w);
+        h = sx_nearest_pow2(h);
+    }
+    *size = sx_ivec2i(w, h);
+    return num_layers;
+}
+
+// bounding box of the pixels that pass the alpha threshold, grown by a pixel like the dilated
+// outline that sprite_rect comes from
+static sx_irect atlasc__alpha_rect(const uint8_t* pixels, int w, int h, int alpha_threshold)
+{
+    sx_irect rc = sx_irecti(INT_MAX, INT_MAX, INT_MIN, INT_MIN);
+    for (int y = 0; y < h; y++) {
+        const uint8_t* row = pixels + y * w * 4;
+        for (int x = 0; x < w; x++) {
+            if (row[x * 4 + 3] >= alpha_threshold)
+                sx_irect_add_point(&rc, sx_ivec2i(x, y));
+        }
+    }
+    if (rc.xmin > rc.xmax)
+        return sx_irecti(0, 0, 1, 1);
+    return sx_irecti(sx_max(rc.xmin - 1, 0), sx_max(rc.ymin - 1, 0), sx_min(rc.xmax + 2, w),
+                     sx_min(rc.ymax + 2, h));
+}
+
+// averages `f`x`f` blocks, for scales of 1/2 and 1/4. source pixels past dw*f, dh*f are dropped
+static bool atlasc__box_downsample(const uint8_t* src, int sw, int sh, uint8_t* dst, int dw, int dh,
+                                   int f)
+{
+    sx_assert(f == 2 || f == 4);
+    sx_assert(dw * f <= sw && dh * f <= sh);
+    sx_unused(sh);
+    int row_count = dw * f * 4;
+    uint16_t* sums = atlasc__malloc(sizeof(uint16_t) * row_count, g_alloc_ctx);
+    if (!sums) {
+        sx_out_of_memory();
+        return false;
+    }
+    int shift = f == 2 ? 2 : 4;
+
+    for (int y = 0; y < dh; y++) {
+        // vertical sums of f rows
+        sx_memset(sums, 0x0, sizeof(uint16_t) * row_count);
+        for (int k = 0; k < f; k++) {
+            const uint8_t* row = src + (size_t)(y * f + k) * sw * 4;
+            int i = 0;
+#if ATLASC__SSE2
+            const __m128i zero = _mm_setzero_si128();
+            for (; i + 16 <= row_count; i += 16) {
+                __m128i v = _mm_loadu_si128((const __m128i*)(row + i));
+                __m128i* s = (__m128i*)(sums + i);
+                _mm_storeu_si128(s, _mm_add_epi16(_mm_loadu_si128(s), _mm_unpacklo_epi8(v, zero)));
+                _mm_storeu_si128(s + 1, _mm_add_epi16(_mm_loadu_si128(s + 1),
+                                                      _mm_unpackhi_epi8(v, zero)));
+            }
+#endif
+            for (; i < row_count; i++)
+                sums[i] += row[i];
+        }
+
+        // horizontal sums of f pixels
+        uint8_t* out = dst + (size_t)y * dw * 4;
+        int x = 0;
+#if ATLASC__SSE2
+        const __m128i round = _mm_set1_epi16((int16_t)(1 << (shift - 1)));
+        for (; x < dw; x++) {
+            const __m128i* s = (const __m128i*)(sums + x * f * 4);
+            __m128i v = _mm_loadu_si128(s);
+            if (f == 4)
+                v = _mm_add_epi16(v, _mm_loadu_si128(s + 1));
+            v = _mm_add_epi16(v, _mm_srli_si128(v, 8));
+            v = _mm_srli_epi16(_mm_add_epi16(v, round), shift);
+            uint32_t texel = (uint32_t)_mm_cvtsi128_si32(_mm_packus_epi16(v, v));
+            sx_memcpy(out + x * 4, &texel, 4);
+        }
+#endif
+        for (; x < dw; x++) {
+            for (int c = 0; c < 4; c++) {
+                int sum = 0;
+                for (int k = 0; k < f; k++)
+                    sum += sums[(x * f + k) * 4 + c];
+                out[x * 4 + c] = (uint8_t)((sum + (1 << (shift - 1))) >> shift);
+            }
+        }
+    }
+
+    atlasc__free(sums, g_alloc_ctx);
+    return true;
+}
+
+// nearest filter, integer upscales copy each source pixel to a block of pixels
+static bool atlasc__nearest_resize(const uint8_t* src, int sw, int sh, uint8_t* dst, int dw, int dh)
+{
+    int* xmap = atlasc__malloc(sizeof(int) * dw, g_alloc_ctx);
+    if (!xmap) {
+        sx_out_of_memory();
+        return false;
+    }
+    for (int x = 0; x < dw; x++)
+        xmap[x] = sx_min((int)(((int64_t)x * 2 + 1) * sw / (dw * 2)), sw - 1);
+
+    const uint32_t* src_pixels = (const uint32_t*)src;
+    uint32_t* dst_pixels = (uint32_t*)dst;
+    int prev_sy = -1;
+    for (int y = 0; y < dh; y++) {
+        int sy = sx_min((int)(((int64_t)y * 2 + 1) * sh / (dh * 2)), sh - 1);
+        uint32_t* row = dst_pixels + (size_t)y * dw;
+        if (sy == prev_sy) {
+            sx_memcpy(row, row - dw, sizeof(uint32_t) * dw);
+            continue;
+        }
+        const uint32_t* src_row = src_pixels + (size_t)sy * sw;
+        for (int x = 0; x < dw; x++)
+            row[x] = src_row[xmap[x]];
+        prev_sy = sy;
     }
-    spr->num_tris = (uint16_t)tris->num_triangles;
-    spr->num_points = (int)tris->num_points;
 
-    tri_delaunay2d_release(tris);
-    atlasc__free(temp_pts, g_alloc_ctx);
+    atlasc__free(xmap, g_alloc_ctx);
+    return true;
 }
 
-static bool atlasc__save(const atlasc_args_files* args, const atlasc_sprite* sprites,
-                         int num_sprites, const uint8_t* dst, int dst_w, int dst_h)
+// same as stbir_resize_uint8, with the scratch memory taken from `scratch` (if not NULL)
+static bool atlasc__resize_general(atlasc__resize_scratch* scratch, const uint8_t* src, int sw,
+                                   int sh, uint8_t* dst, int dw, int dh)
 {
-    char file_ext[32];
-    char basename[256];
-    char image_filepath[256];
-    char image_filename[256];
-
-    sx_os_path_splitext(file_ext, sizeof(file_ext), basename, sizeof(basename), args->out_filepath);
-    sx_strcpy(image_filepath, sizeof(image_filepath), basename);
-    sx_strcat(image_filepath, sizeof(image_filepath), ".png");
+    return stbir_resize_uint8_generic(src, sw, sh, 4 * sw, dst, dw, dh, 4 * dw, 4,
+                                      STBIR_ALPHA_CHANNEL_NONE, 0, STBIR_EDGE_CLAMP,
+                                      STBIR_FILTER_DEFAULT, STBIR_COLORSPACE_LINEAR, scratch) != 0;
+}
 
-    if (!stbi_write_png(image_filepath, dst_w, dst_h, 4, dst, dst_w * 4)) {
-        printf("could not write image: %s\n", image_filepath);
+// picks a specialized filter for the common scales (1/2, 1/4, integer upscales) or pixel art and
+// the general one from stb_image_resize for the rest
+static bool atlasc__resize(atlasc__resize_scratch* scratch, const uint8_t* src, int sw, int sh,
+                           uint8_t* dst, int dw, int dh, float scale, bool nearest)
+{
+    if (nearest || (scale >= 2.0f && sx_equal(scale, sx_round(scale), 0.0001f)))
+        return atlasc__nearest_resize(src, sw, sh, dst, dw, dh);
+    if (sx_equal(scale, 0.5f, 0.0001f) || sx_equal(scale, 0.25f, 0.0001f)) {
+        int f = scale > 0.3f ? 2 : 4;
+        if (dw > 0 && dh > 0 && dw * f <= sw && dh * f <= sh)
+            return atlasc__box_downsample(src, sw, sh, dst, dw, dh, f);
     }
-    sx_os_path_basename(image_filename, sizeof(image_filename), image_filepath);
+    return atlasc__resize_general(scratch, src, sw, sh, dst, dw, dh);
+}
 
-    // write atlas description into json file
-    sjson_context* jctx = sjson_create_context(0, 0, (void*)g_alloc);
-    if (!jctx) {
-        sx_assert(0);
-        return false;
+// largest scale (up to args.scale) that makes the atlas fit into `budget` bytes. trimmed rects are
+// measured once at source resolution and each candidate scale only re-packs them. scaled rects
+// get a couple of extra pixels for filter bleeding, so the estimate errs on the small side.
+// returns 0 if it doesn't fit at any scale
+static float atlasc__fit_budget(const atlasc_args_frommem* args)
+{
+    const atlasc_args* cargs = &args->common;
+    int num_images = args->num_images;
+    int num_rp_nodes = cargs->max_width + cargs->max_height;
+    sx_ivec2* sizes = atlasc__malloc(sizeof(sx_ivec2) * num_images, g_alloc_ctx);
+    stbrp_rect* rp_rects = atlasc__malloc(sizeof(stbrp_rect) * num_images * 2, g_alloc_ctx);
+    stbrp_node* rp_nodes = atlasc__malloc(sizeof(stbrp_node) * num_rp_nodes, g_alloc_ctx);
+    int* layers = atlasc__malloc(sizeof(int) * num_images, g_alloc_ctx);
+    float best = 0;
+    if (!sizes || !rp_rects || !rp_nodes || !layers) {
+        sx_out_of_memory();
+        goto cleanup;
     }
 
-    sjson_node* jroot = sjson_mkobject(jctx);
-    sjson_put_string(jctx, jroot, "image", image_filename);
-    sjson_put_int(jctx, jroot, "image_width", dst_w);
-    sjson_put_int(jctx, jroot, "image_height", dst_h);
-
-    sjson_node* jsprites = sjson_put_array(jctx, jroot, "sprites");
-    char name[256];
-    for (int i = 0; i < num_sprites; i++) {
-        const atlasc_sprite* spr = &sprites[i];
-        sjson_node* jsprite = sjson_mkobject(jctx);
-
-        sx_os_path_unixpath(name, sizeof(name), args->in_filepaths[i]);
-        sjson_put_string(jctx, jsprite, "name", name);
-        sjson_put_ints(jctx, jsprite, "size", spr->src_size.n, 2);
-        sjson_put_ints(jctx, jsprite, "sprite_rect", spr->sprite_rect.f, 4);
-        sjson_put_ints(jctx, jsprite, "sheet_rect", spr->sheet_rect.f, 4);
-
-        if (spr->num_tris) {
-            sjson_node* jmesh = sjson_put_obj(jctx, jsprite, "mesh");
-            sjson_put_int(jctx, jmesh, "num_tris", spr->num_tris);
-            sjson_put_int(jctx, jmesh, "num_vertices", spr->num_points);
-            sjson_put_uint16s(jctx, jmesh, "indices", spr->tris, (int)spr->num_tris * 3);
-            sjson_node* jverts = sjson_put_array(jctx, jmesh, "positions");
-            for (int v = 0; v < spr->num_points; v++) {
-                sjson_node* jvert = sjson_mkarray(jctx);
-                sjson_append_element(jvert, sjson_mknumber(jctx, (double)spr->pts[v].x));
-                sjson_append_element(jvert, sjson_mknumber(jctx, (double)spr->pts[v].y));
-                sjson_append_element(jverts, jvert);
-            }
+    for (int i = 0; i < num_images; i++) {
+        const atlasc_image_data* img = &args->images[i];
+        sx_irect rc = img->width > 1 && img->height > 1
+                          ? atlasc__alpha_rect(img->pixels, img->width, img->height,
+                                               cargs->alpha_threshold)
+                          : sx_irecti(0, 0, img->width, img->height);
+        sizes[i] = sx_ivec2i(rc.xmax - rc.xmin, rc.ymax - rc.ymin);
+    }
 
-            sjson_node* juvs = sjson_put_array(jctx, jmesh, "uvs");
-            for (int u = 0; u < spr->num_points; u++) {
-                sjson_node* juv = sjson_mkarray(jctx);
-                sjson_append_element(juv, sjson_mknumber(jctx, (double)spr->uvs[u].x));
-                sjson_append_element(juv, sjson_mknumber(jctx, (double)spr->uvs[u].y));
-                sjson_append_element(juvs, juv);
-            }
+    // the first candidate is the requested scale, then bisect
+    int rc_resize = (cargs->border + cargs->padding) * 2;
+    float lo = 0, hi = cargs->scale;
+    for (int it = 0; it < 16; it++) {
+        float scale = it == 0 ? hi : (lo + hi) * 0.5f;
+        bool fits = true;
+        for (int i = 0; i < num_images && fits; i++) {
+            const atlasc_image_data* img = &args->images[i];
+            fits = (int)((float)img->width * scale) > 0 && (int)((float)img->height * scale) > 0;
+            rp_rects[i] = (stbrp_rect){
+                .id = i,
+                .w = (int)sx_ceil((float)sizes[i].x * scale) + 2 + rc_resize,
+                .h = (int)sx_ceil((float)sizes[i].y * scale) + 2 + rc_resize,
+            };
         }
 
-        sjson_append_element(jsprites, jsprite);
-    }
-
-    char* jout = sjson_encode(jctx, jroot);
-    if (!jout)
-        return false;
-    sx_file_writer writer;
-    if (!sx_file_open_writer(&writer, args->out_filepath, 0)) {
-        printf("could not open file for writing: %s\n", args->out_filepath);
-        return false;
+        sx_ivec2 size = sx_ivec2i(0, 0);
+        int num_layers = fits ? atlasc__pack_pages(cargs, rp_rects, num_images, rp_nodes,
+                                                   rp_rects + num_images, layers, &size)
+                              : 0;
+        fits = num_layers > 0 &&
+               (int64_t)size.x * size.y * g_formats[cargs->format].bytes * num_layers <=
+                   cargs->budget;
+        if (fits) {
+            best = scale;
+            if (it == 0)
+                break;
+            lo = scale;
+        } else {
+            hi = scale;
+        }
     }
-    sx_file_write_text(&writer, jout);
-    sx_file_close_writer(&writer);
 
-    sjson_free_string(jctx, jout);
-    sjson_destroy_context(jctx);
-    return true;
+cleanup:
+    atlasc__free(sizes, g_alloc_ctx);
+    atlasc__free(rp_rects, g_alloc_ctx);
+    atlasc__free(rp_nodes, g_alloc_ctx);
+    atlasc__free(layers, g_alloc_ctx);
+    return best;
 }
 
 PUBLIC_DECL atlasc_atlas_data* atlasc_make_inmem_frommem(const atlasc_args_frommem* args)
@@ -407,44 +4374,118 @@ PUBLIC_DECL atlasc_atlas_data* atlasc_make_inmem_frommem(const atlasc_args_fromm
     if (!g_alloc)
         g_alloc = sx_alloc_malloc();
 
+    // everything is released at err_cleanup, input pixels that no sprite has taken yet too
     int num_sprites = args->num_images;
+    int num_taken = 0;
+    atlasc__memo memo = { 0 };
+    atlasc__resize_scratch resize_scratch = { 0 };
+    stbrp_rect* rp_rects = NULL;
+    stbrp_node* rp_nodes = NULL;
+    int* layers = NULL;
+    uint8_t** index_maps = NULL;
+    atlasc_palette* palettes = NULL;
+    uint8_t* dst = NULL;
+    atlasc_atlas_data* atlas = NULL;
     atlasc_sprite* sprites = atlasc__malloc(sizeof(atlasc_sprite) * num_sprites, g_alloc_ctx);
     if (!sprites) {
         sx_out_of_memory();
-        return NULL;
+        goto err_cleanup;
     }
     sx_memset(sprites, 0x0, sizeof(atlasc_sprite) * num_sprites);
 
-    const atlasc_args* cargs = &args->common;
+    atlasc_args common = args->common;
+    const atlasc_args* cargs = &common;
+    if (cargs->palettes && cargs->format != ATLASC_FORMAT_RGBA8) {
+        sx_snprintf(g_error_str, sizeof(g_error_str),
+                    "palettes need RGBA8 format to keep the palette indices");
+        goto err_cleanup;
+    }
+    if (cargs->colliders && (cargs->colliders < 3 || cargs->colliders > UINT8_MAX)) {
+        sx_snprintf(g_error_str, sizeof(g_error_str),
+                    "colliders need 3 to 255 vertices per piece: %d", cargs->colliders);
+        goto err_cleanup;
+    }
+    if (!atlasc__memo_init(&memo, num_sprites, cargs->cache_dir)) {
+        sx_out_of_memory();
+        goto err_cleanup;
+    }
+    if (cargs->budget > 0) {
+        common.scale = atlasc__fit_budget(args);
+        if (common.scale <= 0) {
+            sx_snprintf(g_error_str, sizeof(g_error_str),
+                        "atlas does not fit into the budget at any scale: %lld bytes",
+                        (long long)cargs->budget);
+            goto err_cleanup;
+        }
+    }
 
+    ATLASC__ZONE_BEGIN("analysis");
     for (int i = 0; i < num_sprites; i++) {
         atlasc_sprite* spr = &sprites[i];
+        ATLASC__ZONE_BEGIN("sprite");
 
         spr->src_size.x = args->images[i].width;
         spr->src_size.y = args->images[i].height;
         sx_assert(args->images[i].width > 0 && args->images[i].height > 0);
         sx_assert(args->images[i].pixels);
         uint8_t* pixels = args->images[i].pixels;
+        spr->src_image = pixels;
+        num_taken++;
+        spr->palette = -1;
+        sx_memcpy(spr->slice, args->images[i].slice, sizeof(spr->slice));
+        sx_assert(spr->slice[0] + spr->slice[2] <= spr->src_size.x);
+        sx_assert(spr->slice[1] + spr->slice[3] <= spr->src_size.y);
+
+        // clearing before a rescale would blend black into the edges, so it's done after it
+        bool rescale = !sx_equal(cargs->scale, 1.0f, 0.0001f);
+        if (cargs->clear_transparent && !rescale)
+            atlasc__clear_transparent((uint32_t*)pixels, spr->src_size.x * spr->src_size.y);
+
+        // collapse stretchable regions, keep at least a pixel of them after rescale
+        if (cargs->nine_slice && atlasc__has_slice(spr->slice)) {
+            int strip = sx_max(1, (int)sx_ceil(1.0f / cargs->scale));
+            int cw, ch;
+            uint8_t* collapsed = atlasc__collapse_slice(pixels, spr->src_size.x, spr->src_size.y,
+                                                        spr->slice, strip, &cw, &ch);
+            if (collapsed) {
+                stbi_image_free(pixels);
+                pixels = collapsed;
+                spr->src_image = pixels;
+                spr->src_size = sx_ivec2i(cw, ch);
+            }
+        }
 
         // rescale
-        if (!sx_equal(cargs->scale, 1.0f, 0.0001f)) {
+        if (rescale) {
             int target_w = (int)((float)spr->src_size.x * cargs->scale);
             int target_h = (int)((float)spr->src_size.y * cargs->scale);
             uint8_t* resized_pixels = atlasc__malloc(4 * target_w * target_h, g_alloc_ctx);
             if (!resized_pixels) {
                 sx_out_of_memory();
-                return NULL;
+                ATLASC__ZONE_END("sprite", 0, 0);
+                ATLASC__ZONE_END("analysis", i, 0);
+                goto err_cleanup;
             }
 
-            if (!stbir_resize_uint8(pixels, spr->src_size.x, spr->src_size.y, 4 * spr->src_size.x,
-                                    resized_pixels, target_w, target_h, 4 * target_w, 4)) {
+            if (!atlasc__resize(cargs->no_resize_cache ? NULL : &resize_scratch, pixels,
+                                spr->src_size.x, spr->src_size.y, resized_pixels, target_w,
+                                target_h, cargs->scale, cargs->nearest)) {
                 sx_snprintf(g_error_str, sizeof(g_error_str), "could not resize image: #%d", i + 1);
-                atlasc__free_sprites(sprites, num_sprites);
-                return NULL;
+                atlasc__free(resized_pixels, g_alloc_ctx);
+                ATLASC__ZONE_END("sprite", 0, 0);
+                ATLASC__ZONE_END("analysis", i, 0);
+                goto err_cleanup;
             }
 
             stbi_image_free(pixels);
+            if (cargs->clear_transparent)
+                atlasc__clear_transparent((uint32_t*)resized_pixels, target_w * target_h);
 
+            for (int k = 0; k < 4; k++) {
+                int size = (k & 1) ? target_h : target_w;
+                int src_size = (k & 1) ? spr->src_size.y : spr->src_size.x;
+                spr->slice[k] = (spr->slice[k] * size + src_size / 2) / src_size;
+            }
             spr->src_size.x = target_w;
             spr->src_size.y = target_h;
             pixels = resized_pixels;
@@ -460,6 +4501,29 @@ PUBLIC_DECL atlasc_atlas_data* atlasc_make_inmem_frommem(const atlasc_args_fromm
                                                         cargs->alpha_threshold);
         atlasc__free(alpha, g_alloc_ctx);
 
+        // skip the analysis if another sprite had the same mask
+        bool memoize = spr->src_size.x > 1 && spr->src_size.y > 1;
+        uint64_t mask_key = 0;
+        if (memoize) {
+            mask_key = atlasc__mask_key(thresholded, spr->src_size.x, spr->src_size.y, cargs);
+            const atlasc__analysis* entry = atlasc__memo_find(&memo, mask_key, thresholded,
+                                                              spr->src_size.x, spr->src_size.y);
+            if (entry) {
+                bool applied = atlasc__memo_apply(entry, spr) &&
+                               (!cargs->hit_mask ||
+                                atlasc__make_hit_mask(spr, thresholded, cargs->hit_mask)) &&
+                               (!cargs->check_mesh || !spr->pts ||
+                                atlasc__check_mesh(spr, thresholded));
+                atlasc__free(thresholded, g_alloc_ctx);
+                if (!applied) {
+                    ATLASC__ZONE_END("sprite", 0, 0);
+                    ATLASC__ZONE_END("analysis", i, 0);
+                    goto err_cleanup;
+                }
+                goto quantize;
+            }
+        }
+
         if (spr->src_size.x > 1 && spr->src_size.y > 1) {
             uint8_t* dialate_thres =
                 s2o_dilate_thresholded(thresholded, spr->src_size.x, spr->src_size.y);
@@ -489,73 +4553,184 @@ PUBLIC_DECL atlasc_atlas_data* atlasc_make_inmem_frommem(const atlasc_args_fromm
             pts[3] = (s2o_point) {0, spr->src_size.y};
         }
 
-        // generate mesh if set in arguments
-        if (cargs->mesh) {
-            atlasc__make_mesh(spr, pts, pt_count, cargs->max_verts_per_mesh, thresholded,
-                              spr->src_size.x, spr->src_size.y);
+        // generate mesh if set in arguments, colliders keep the outline until it's decomposed
+        if (cargs->mesh || cargs->colliders) {
+            ATLASC__ZONE_BEGIN("mesh");
+            int num_verts;
+            s2o_point* outline =
+                atlasc__simplify_outline(pts, pt_count, cargs->max_verts_per_mesh, thresholded,
+                                         spr->src_size.x, spr->src_size.y, &num_verts);
+            if (outline && cargs->mesh)
+                atlasc__make_mesh(spr, outline, num_verts);
+            if (outline && cargs->colliders) {
+                spr->collider_pts = atlasc__malloc(sizeof(sx_ivec2) * num_verts, g_alloc_ctx);
+                if (spr->collider_pts) {
+                    for (int k = 0; k < num_verts; k++)
+                        spr->collider_pts[k] = sx_ivec2i(outline[k].x, outline[k].y);
+                    spr->num_collider_pts = num_verts;
+                }
+            }
+            atlasc__free(outline, g_alloc_ctx);
+            ATLASC__ZONE_END("mesh", spr->num_tris, 0);
         }
 
         atlasc__free(pts, g_alloc_ctx);
-        atlasc__free(thresholded, g_alloc_ctx);
         spr->sprite_rect = sprite_rect;
+        if ((cargs->hit_mask && !atlasc__make_hit_mask(spr, thresholded, cargs->hit_mask)) ||
+            (cargs->check_mesh && spr->pts && !atlasc__check_mesh(spr, thresholded))) {
+            atlasc__free(thresholded, g_alloc_ctx);
+            ATLASC__ZONE_END("sprite", 0, 0);
+            ATLASC__ZONE_END("analysis", i, 0);
+            goto err_cleanup;
+        }
+        if (memoize)
+            atlasc__memo_add(&memo, mask_key, thresholded, spr);
+        else
+            atlasc__free(thresholded, g_alloc_ctx);
+
+    quantize:
+
+        // replace full precision positions with 16bit offsets from the sprite_rect
+        // UVs are not generated in this case, they are derived from the sheet_rect
+        if (cargs->quantize_mesh && spr->pts) {
+            spr->qpts = atlasc__malloc(sizeof(int16_t) * 2 * spr->num_points, g_alloc_ctx);
+            if (!spr->qpts) {
+                sx_out_of_memory();
+                ATLASC__ZONE_END("sprite", 0, 0);
+                ATLASC__ZONE_END("analysis", i, 0);
+                goto err_cleanup;
+            }
+            for (int pi = 0; pi < spr->num_points; pi++) {
+                sx_ivec2 pt = sx_ivec2_sub(spr->pts[pi], spr->sprite_rect.vmin);
+                sx_assert(pt.x >= INT16_MIN && pt.x <= INT16_MAX);
+                sx_assert(pt.y >= INT16_MIN && pt.y <= INT16_MAX);
+                spr->qpts[pi * 2] = (int16_t)pt.x;
+                spr->qpts[pi * 2 + 1] = (int16_t)pt.y;
+            }
+            atlasc__free(spr->pts, g_alloc_ctx);
+            spr->pts = NULL;
+        }
+        ATLASC__ZONE_END("sprite", 1, (int64_t)spr->src_size.x * spr->src_size.y * 4);
+    }
+    ATLASC__ZONE_END("analysis", num_sprites, 0);
+
+    int64_t cache_bytes_written = memo.bytes_written;
+    atlasc__free(resize_scratch.mem, g_alloc_ctx);
+    resize_scratch.mem = NULL;
+    atlasc__memo_release(&memo);
+    if (cargs->cache_dir && cargs->cache_limit > 0)
+        atlasc__cache_gc(cargs->cache_dir, cargs->cache_limit, cache_bytes_written);
+
+    // convex decomposition of the outlines, sprites are independent
+    if (cargs->colliders) {
+        ATLASC__ZONE_BEGIN("colliders");
+        atlasc__collider_job_data job = { .sprites = sprites, .max_verts = cargs->colliders };
+        if (!atlasc__parallel_for(atlasc__collider_job, &job, num_sprites) || job.failed) {
+            if (job.failed)
+                sx_out_of_memory();
+            ATLASC__ZONE_END("colliders", 0, 0);
+            goto err_cleanup;
+        }
+        ATLASC__ZONE_END("colliders", num_sprites, 0);
     }
 
     // pack sprites into a sheet
-    stbrp_context rp_ctx;
-    int max_width = cargs->max_width;
-    int max_height = cargs->max_height;
-    int num_rp_nodes = max_width + max_height;
-    stbrp_rect* rp_rects = atlasc__malloc(num_sprites * sizeof(stbrp_rect), g_alloc_ctx);
-    stbrp_node* rp_nodes = atlasc__malloc(num_rp_nodes * sizeof(stbrp_node), g_alloc_ctx);
-    if (!rp_rects || !rp_nodes) {
+    ATLASC__ZONE_BEGIN("pack");
+    int num_rp_nodes = cargs->max_width + cargs->max_height;
+    rp_rects = atlasc__malloc(num_sprites * 2 * sizeof(stbrp_rect), g_alloc_ctx);
+    rp_nodes = atlasc__malloc(num_rp_nodes * sizeof(stbrp_node), g_alloc_ctx);
+    layers = atlasc__malloc(num_sprites * sizeof(int) * 2, g_alloc_ctx);
+    index_maps = atlasc__malloc(num_sprites * sizeof(uint8_t*), g_alloc_ctx);
+    if (!rp_rects || !rp_nodes || !layers || !index_maps) {
         sx_out_of_memory();
-        return NULL;
+        ATLASC__ZONE_END("pack", 0, 0);
+        goto err_cleanup;
     }
+    sx_memset(index_maps, 0x0, num_sprites * sizeof(uint8_t*));
     sx_memset(rp_rects, 0x0, sizeof(stbrp_rect) * num_sprites);
+    stbrp_rect* rp_packed = rp_rects + num_sprites;
+    int* sources = layers + num_sprites;
+    for (int i = 0; i < num_sprites; i++)
+        sources[i] = i;
+
+    // duplicates and recolors are not packed, they use the pixels of their source sprite
+    if ((cargs->dedupe && !atlasc__dedupe_sprites(sprites, num_sprites, sources)) ||
+        (cargs->palettes &&
+         !atlasc__find_palettes(sprites, num_sprites, sources, index_maps, &palettes))) {
+        ATLASC__ZONE_END("pack", 0, 0);
+        goto err_cleanup;
+    }
 
+    int num_rects = 0;
     for (int i = 0; i < num_sprites; i++) {
+        if (sources[i] != i)
+            continue;
         sx_irect rc = sprites[i].sprite_rect;
         int rc_resize = (cargs->border + cargs->padding) * 2;
-        rp_rects[i].w = (rc.xmax - rc.xmin) + rc_resize;
-        rp_rects[i].h = (rc.ymax - rc.ymin) + rc_resize;
+        rp_rects[num_rects].id = i;
+        rp_rects[num_rects].w = (rc.xmax - rc.xmin) + rc_resize;
+        rp_rects[num_rects].h = (rc.ymax - rc.ymin) + rc_resize;
+        num_rects++;
     }
-    stbrp_init_target(&rp_ctx, max_width, max_height, rp_nodes, num_rp_nodes);
-    sx_irect final_rect = sx_irecti(INT_MAX, INT_MAX, INT_MIN, INT_MIN);
-    if (stbrp_pack_rects(&rp_ctx, rp_rects, num_sprites)) {
-        for (int i = 0; i < num_sprites; i++) {
-            atlasc_sprite* spr = &sprites[i];
-            sx_irect sheet_rect =
-                sx_irectwh(rp_rects[i].x, rp_rects[i].y, rp_rects[i].w, rp_rects[i].h);
-
-            // calculate the total size of output image
-            sx_irect_add_point(&final_rect, sheet_rect.vmin);
-            sx_irect_add_point(&final_rect, sheet_rect.vmax);
 
-            // shrink back rect and set the real sheet_rect for the sprite
-            spr->sheet_rect =
-                sx_irect_expand(sheet_rect, sx_ivec2i(-cargs->border, -cargs->border));
-        }
+    sx_ivec2 dst_size;
+    int num_layers =
+        atlasc__pack_pages(cargs, rp_rects, num_rects, rp_nodes, rp_packed, layers, &dst_size);
+    if (num_layers == 0) {
+        sx_snprintf(g_error_str, sizeof(g_error_str), "sprite does not fit into %dx%d image: #%d",
+                    cargs->max_width, cargs->max_height, rp_rects[0].id + 1);
+        ATLASC__ZONE_END("pack", 0, 0);
+        goto err_cleanup;
+    }
+    if (num_layers < 0) {
+        sx_snprintf(g_error_str, sizeof(g_error_str), "sprites need more than %d pages",
+                    ATLASC__MAX_LAYERS);
+        ATLASC__ZONE_END("pack", 0, 0);
+        goto err_cleanup;
+    }
+    // pages are addressed with int (png rows include a filter byte), the whole image with size_t
+    int64_t page_size = (int64_t)dst_size.y * ((int64_t)dst_size.x * 4 + 1);
+    if (page_size > INT32_MAX || (uint64_t)dst_size.x * dst_size.y * 4 * num_layers > SIZE_MAX) {
+        sx_snprintf(g_error_str, sizeof(g_error_str), "atlas is too large: %dx%d, %d pages",
+                    dst_size.x, dst_size.y, num_layers);
+        ATLASC__ZONE_END("pack", 0, 0);
+        goto err_cleanup;
+    }
+    // the scale is estimated from source bounds, rounding of the rescaled sprites and the packer
+    // can still make the real atlas larger
+    int64_t atlas_bytes =
+        (int64_t)dst_size.x * dst_size.y * g_formats[cargs->format].bytes * num_layers;
+    if (cargs->budget > 0 && atlas_bytes > cargs->budget) {
+        sx_snprintf(g_error_str, sizeof(g_error_str),
+                    "atlas does not fit into the budget at scale %.3f: %lld > %lld bytes",
+                    cargs->scale, (long long)atlas_bytes, (long long)cargs->budget);
+        ATLASC__ZONE_END("pack", 0, 0);
+        goto err_cleanup;
     }
 
-    int dst_w = final_rect.xmax - final_rect.xmin;
-    int dst_h = final_rect.ymax - final_rect.ymin;
-    // make output size divide by 4 by default
-    dst_w = sx_align_mask(dst_w, 3);
-    dst_h = sx_align_mask(dst_h, 3);
+    for (int i = 0; i < num_sprites; i++) {
+        atlasc_sprite* spr = &sprites[i];
+        const stbrp_rect* rc = &rp_packed[sources[i]];
+        sx_irect sheet_rect = sx_irectwh(rc->x, rc->y, rc->w, rc->h);
 
-    if (cargs->pot) {
-        dst_w = sx_nearest_pow2(dst_w);
-        dst_h = sx_nearest_pow2(dst_h);
+        // shrink back rect and set the real sheet_rect for the sprite
+        spr->sheet_rect = sx_irect_expand(sheet_rect, sx_ivec2i(-cargs->border, -cargs->border));
+        spr->layer = layers[sources[i]];
     }
+    ATLASC__ZONE_END("pack", num_rects, 0);
+    int dst_w = dst_size.x;
+    int dst_h = dst_size.y;
 
-    uint8_t* dst = atlasc__malloc(dst_w * dst_h * 4, g_alloc_ctx);
-    sx_memset(dst, 0x0, dst_w * dst_h * 4);
+    size_t dst_bytes = (size_t)dst_w * dst_h * 4 * num_layers;
+    dst = atlasc__malloc(dst_bytes, g_alloc_ctx);
     if (!dst) {
         sx_out_of_memory();
-        return NULL;
+        goto err_cleanup;
     }
+    sx_memset(dst, 0x0, dst_bytes);
 
     // calculate UVs for sprite meshes
+    ATLASC__ZONE_BEGIN("blit");
     if (cargs->mesh) {
         for (int i = 0; i < num_sprites; i++) {
             atlasc_sprite* spr = &sprites[i];
@@ -565,11 +4740,14 @@ PUBLIC_DECL atlasc_atlas_data* atlasc_make_inmem_frommem(const atlasc_args_fromm
                 sx_ivec2 offset = spr->sprite_rect.vmin;
                 sx_ivec2 sheet_pos =
                     sx_ivec2i(spr->sheet_rect.xmin + padding, spr->sheet_rect.ymin + padding);
+                int w = spr->sprite_rect.xmax - spr->sprite_rect.xmin;
+                int h = spr->sprite_rect.ymax - spr->sprite_rect.ymin;
                 sx_ivec2* uvs = atlasc__malloc(sizeof(sx_ivec2) * spr->num_points, g_alloc_ctx);
                 sx_assert(uvs);
                 for (int pi = 0; pi < spr->num_points; pi++) {
-                    sx_ivec2 pt = spr->pts[pi];
-                    uvs[pi] = sx_ivec2_add(sx_ivec2_sub(pt, offset), sheet_pos);
+                    sx_ivec2 pt = atlasc__transform_pt(sx_ivec2_sub(spr->pts[pi], offset), w, h,
+                                                       spr->transform);
+                    uvs[pi] = sx_ivec2_add(pt, sheet_pos);
                 }
 
                 spr->uvs = uvs;
@@ -579,6 +4757,8 @@ PUBLIC_DECL atlasc_atlas_data* atlasc_make_inmem_frommem(const atlasc_args_fromm
 
     for (int i = 0; i < num_sprites; i++) {
         const atlasc_sprite* spr = &sprites[i];
+        if (sources[i] != i)
+            continue;
 
         // calculate UVs for sprite-meshes
 
@@ -586,27 +4766,242 @@ PUBLIC_DECL atlasc_atlas_data* atlasc_make_inmem_frommem(const atlasc_args_fromm
         sx_irect dstrc =
             sx_irect_expand(spr->sheet_rect, sx_ivec2i(-cargs->padding, -cargs->padding));
         sx_irect srcrc = spr->sprite_rect;
-        atlasc__blit(dst, dstrc.xmin, dstrc.ymin, dst_w * 4, spr->src_image, srcrc.xmin, srcrc.ymin,
-                     srcrc.xmax - srcrc.xmin, srcrc.ymax - srcrc.ymin, spr->src_size.x * 4, 32);
+        uint8_t* layer = dst + (size_t)spr->layer * dst_w * dst_h * 4;
+        if (index_maps[i]) {
+            // indexed sprites: R = palette index, A = 255
+            int w = srcrc.xmax - srcrc.xmin;
+            for (int y = 0, h = srcrc.ymax - srcrc.ymin; y < h; y++) {
+                uint8_t* row = layer + ((dstrc.ymin + y) * dst_w + dstrc.xmin) * 4;
+                for (int x = 0; x < w; x++) {
+                    uint8_t texel[4] = { index_maps[i][y * w + x], 0, 0, 255 };
+                    sx_memcpy(row + x * 4, texel, 4);
+                }
+            }
+            continue;
+        }
+        atlasc__blit(layer, dstrc.xmin, dstrc.ymin, dst_w * 4, spr->src_image, srcrc.xmin,
+                     srcrc.ymin, srcrc.xmax - srcrc.xmin, srcrc.ymax - srcrc.ymin,
+                     spr->src_size.x * 4, 32);
+
+        // dither each sprite on its own
+        if (cargs->format != ATLASC_FORMAT_RGBA8) {
+            sx_irect rc = sx_irecti(dstrc.xmin, dstrc.ymin, dstrc.xmin + srcrc.xmax - srcrc.xmin,
+                                    dstrc.ymin + srcrc.ymax - srcrc.ymin);
+            if (!atlasc__quantize_rect(layer, dst_w * 4, rc, cargs->format, cargs->dither)) {
+                ATLASC__ZONE_END("blit", 0, 0);
+                goto err_cleanup;
+            }
+        }
     }
+    ATLASC__ZONE_END("blit", num_rects, dst_bytes);
 
-    atlasc_atlas_data* atlas = atlasc__malloc(sizeof(atlasc_atlas_data), g_alloc_ctx);
-    if (!atlas) {
+    atlas = atlasc__malloc(sizeof(atlasc_atlas_data), g_alloc_ctx);
+    int num_palettes = sx_array_count(palettes);
+    atlasc_palette* atlas_palettes =
+        num_palettes ? atlasc__malloc(sizeof(atlasc_palette) * num_palettes, g_alloc_ctx) : NULL;
+    if (!atlas || (num_palettes && !atlas_palettes)) {
         sx_out_of_memory();
-        return NULL;
+        atlasc__free(atlas_palettes, g_alloc_ctx);
+        goto err_cleanup;
     }
+    if (num_palettes)
+        sx_memcpy(atlas_palettes, palettes, sizeof(atlasc_palette) * num_palettes);
+    atlas->palettes = atlas_palettes;
+    atlas->num_palettes = num_palettes;
     atlas->atlas_image.pixels = dst;
     atlas->atlas_image.width = dst_w;
     atlas->atlas_image.height = dst_h;
+    atlas->num_layers = num_layers;
+    atlas->scale = cargs->scale;
+    atlas->format = cargs->format;
     atlas->num_sprites = num_sprites;
     atlas->sprites = sprites;
 
     atlasc__free(rp_nodes, g_alloc_ctx);
     atlasc__free(rp_rects, g_alloc_ctx);
+    atlasc__free(layers, g_alloc_ctx);
+    for (int i = 0; i < num_sprites; i++)
+        atlasc__free(index_maps[i], g_alloc_ctx);
+    atlasc__free(index_maps, g_alloc_ctx);
+    sx_array_free(g_alloc, palettes);
 
     return atlas;
+
+err_cleanup:
+    atlasc__free(resize_scratch.mem, g_alloc_ctx);
+    atlasc__memo_release(&memo);
+    atlasc__free(rp_nodes, g_alloc_ctx);
+    atlasc__free(rp_rects, g_alloc_ctx);
+    atlasc__free(layers, g_alloc_ctx);
+    if (index_maps) {
+        for (int i = 0; i < num_sprites; i++)
+            atlasc__free(index_maps[i], g_alloc_ctx);
+    }
+    atlasc__free(index_maps, g_alloc_ctx);
+    sx_array_free(g_alloc, palettes);
+    atlasc__free(dst, g_alloc_ctx);
+    atlasc__free(atlas, g_alloc_ctx);
+    if (sprites)
+        atlasc__free_sprites(sprites, num_sprites);
+    for (int i = num_taken; i < num_sprites; i++)
+        stbi_image_free(args->images[i].pixels);
+    return NULL;
+}
+
+
+// width and height from the image header, without decoding
+static bool atlasc__image_info(const char* filepath, int* width, int* height)
+{
+    uint8_t hdr[20] = { 0 };
+    sx_file_reader reader;
+    if (!sx_file_open_reader(&reader, filepath))
+        return false;
+    int size = (int)sx_min(sx_file_seekr(&reader, 0, SX_WHENCE_END), (int64_t)sizeof(hdr));
+    sx_file_seekr(&reader, 0, SX_WHENCE_BEGIN);
+    sx_file_read(&reader, hdr, size);
+    sx_file_close_reader(&reader);
+
+    const char* ext = sx_strrchar(filepath, '.');
+    uint32_t magic = atlasc__read_le32(hdr);
+    if (size >= 12 && magic == ATLASC__QOI_MAGIC) {
+        *width = (int)atlasc__read_be32(hdr + 4);
+        *height = (int)atlasc__read_be32(hdr + 8);
+    } else if (size >= 20 && magic == ATLASC__DDS_MAGIC) {
+        *width = (int)atlasc__read_le32(hdr + 16);
+        *height = (int)atlasc__read_le32(hdr + 12);
+    } else if (size >= 12 && magic == ATLASC_RAW_MAGIC) {
+        *width = (int)atlasc__read_le32(hdr + 4);
+        *height = (int)atlasc__read_le32(hdr + 8);
+    } else if (ext && (sx_strequalnocase(ext, ".raw") || sx_strequalnocase(ext, ".rgba"))) {
+        return atlasc__raw_size_from_name(filepath, width, height);
+    } else {
+        int comp;
+        return stbi_info(filepath, width, height, &comp) != 0;
+    }
+    return true;
+}
+
+enum atlasc__load_status {
+    ATLASC__LOAD_OK = 0,
+    ATLASC__LOAD_NOT_FOUND,
+    ATLASC__LOAD_INVALID_FORMAT,
+    ATLASC__LOAD_INVALID_NINE_PATCH
+};
+
+typedef struct atlasc__load_job {
+    char** filepaths;
+    atlasc_image_data* images;
+    int* status;
+    int first;    // first image of the batch
+} atlasc__load_job;
+
+static void atlasc__load_image_job(int index, void* user)
+{
+    atlasc__load_job* job = user;
+    int i = job->first + index;
+    const char* filepath = job->filepaths[i];
+    atlasc_image_data* img = &job->images[i];
+    if (!sx_os_path_isfile(filepath)) {
+        job->status[i] = ATLASC__LOAD_NOT_FOUND;
+        return;
+    }
+
+    ATLASC__ZONE_BEGIN("decode_image");
+    atlasc__read_buffer read_buff = { 0 };
+    img->pixels = atlasc__load_image(filepath, &img->width, &img->height, &read_buff);
+    atlasc__free(read_buff.data, g_alloc_ctx);
+    ATLASC__ZONE_END("decode_image", 1, img->pixels ? (int64_t)img->width * img->height * 4 : 0);
+    if (!img->pixels)
+        job->status[i] = ATLASC__LOAD_INVALID_FORMAT;
+    else if (atlasc__is_nine_patch(filepath) && !atlasc__load_nine_patch(img))
+        job->status[i] = ATLASC__LOAD_INVALID_NINE_PATCH;
 }
 
+// decodes input images in parallel. the images that are decoded at once are admitted by memory:
+// decoded images stay resident and each decode needs about its file and its pixels on top of it,
+// which must fit into max_memory (or the cgroup limit). a larger image is decoded on its own
+static bool atlasc__load_images(const atlasc_args_files* args, atlasc_image_data* images)
+{
+    int num_images = args->num_files;
+    int64_t max_memory = args->max_memory > 0 ? args->max_memory : atlasc__cgroup_memory();
+    int* status = atlasc__malloc(sizeof(int) * num_images, g_alloc_ctx);
+    int64_t* costs = atlasc__malloc(sizeof(int64_t) * num_images * 2, g_alloc_ctx);
+    if (!status || !costs) {
+        sx_out_of_memory();
+        atlasc__free(status, g_alloc_ctx);
+        atlasc__free(costs, g_alloc_ctx);
+        return false;
+    }
+    sx_memset(status, 0x0, sizeof(int) * num_images);
+
+    if (max_memory > 0) {
+        for (int i = 0; i < num_images; i++) {
+            int w = 0, h = 0;
+            int64_t file_size = 0;
+            sx_file_reader reader;
+            if (sx_file_open_reader(&reader, args->in_filepaths[i])) {
+                file_size = sx_file_seekr(&reader, 0, SX_WHENCE_END);
+                sx_file_close_reader(&reader);
+            }
+            atlasc__image_info(args->in_filepaths[i], &w, &h);
+            costs[i * 2] = (int64_t)sx_max(w, 0) * sx_max(h, 0) * 4;    // resident
+            costs[i * 2 + 1] = costs[i * 2] + file_size;                // while decoding
+        }
+    }
+
+    atlasc__load_job job = { .filepaths = args->in_filepaths, .images = images, .status = status };
+    int64_t resident = 0;
+    for (int first = 0; first < num_images;) {
+        int count = num_images - first;
+        if (max_memory > 0) {
+            int64_t batch = 0;
+            count = 0;
+            while (first + count < num_images) {
+                const int64_t* cost = &costs[(first + count) * 2];
+                if (count > 0 && resident + batch + cost[0] + cost[1] > max_memory)
+                    break;
+                batch += cost[0] + cost[1];
+                count++;
+            }
+            for (int i = first; i < first + count; i++)
+                resident += costs[i * 2];
+        }
+
+        job.first = first;
+        if (!atlasc__parallel_for(atlasc__load_image_job, &job, count)) {
+            atlasc__free(status, g_alloc_ctx);
+            atlasc__free(costs, g_alloc_ctx);
+            return false;
+        }
+        first += count;
+    }
+
+    bool r = true;
+    for (int i = 0; i < num_images && r; i++) {
+        const char* filepath = args->in_filepaths[i];
+        switch (status[i]) {
+        case ATLASC__LOAD_NOT_FOUND:
+            sx_snprintf(g_error_str, sizeof(g_error_str), "input image not found: %s", filepath);
+            r = false;
+            break;
+        case ATLASC__LOAD_INVALID_FORMAT:
+            sx_snprintf(g_error_str, sizeof(g_error_str), "invalid image format: %s", filepath);
+            r = false;
+            break;
+        case ATLASC__LOAD_INVALID_NINE_PATCH:
+            sx_snprintf(g_error_str, sizeof(g_error_str), "invalid nine-patch image: %s",
+                        filepath);
+            r = false;
+            break;
+        default:
+            break;
+        }
+    }
+
+    atlasc__free(status, g_alloc_ctx);
+    atlasc__free(costs, g_alloc_ctx);
+    return r;
+}
 
 PUBLIC_DECL atlasc_atlas_data* atlasc_make_inmem(const atlasc_args_files* args)
 {
@@ -623,29 +5018,18 @@ PUBLIC_DECL atlasc_atlas_data* atlasc_make_inmem(const atlasc_args_files* args)
     }
     sx_memset(images, 0x0, sizeof(atlasc_image_data) * num_images);
 
-    for (int i = 0; i < num_images; i++) {
-        int comp;
-        if (!sx_os_path_isfile(args->in_filepaths[i])) {
-            sx_snprintf(g_error_str, sizeof(g_error_str), "input image not found: %s",
-                        args->in_filepaths[i]);
-            goto err_cleanup;
-        }
-        images[i].pixels =
-            stbi_load(args->in_filepaths[i], &images[i].width, &images[i].height, &comp, 4);
-        if (!images[i].pixels) {
-            sx_snprintf(g_error_str, sizeof(g_error_str), "invalid image format: %s",
-                        args->in_filepaths[i]);
-            goto err_cleanup;
-        }
-    }
+    ATLASC__ZONE_BEGIN("decode");
+    bool loaded = atlasc__load_images(args, images);
+    ATLASC__ZONE_END("decode", loaded ? num_images : 0, 0);
+    if (!loaded)
+        goto err_cleanup;
 
     atlasc_args_frommem args2 = { .common = args->common,
                                   .images = images,
                                   .num_images = num_images };
+    // the pixels are taken by the build, whether it fails or not
     atlasc_atlas_data* atlas = atlasc_make_inmem_frommem(&args2);
-    if (!atlas)
-        return NULL;
-
+    atlasc__free(images, g_alloc_ctx);
     return atlas;
 
 err_cleanup:
@@ -666,14 +5050,49 @@ PUBLIC_DECL void atlasc_free(atlasc_atlas_data* atlas)
         atlasc__free_sprites(atlas->sprites, atlas->num_sprites);
     if (atlas->atlas_image.pixels)
         atlasc__free(atlas->atlas_image.pixels, g_alloc_ctx);
+    if (atlas->palettes)
+        atlasc__free(atlas->palettes, g_alloc_ctx);
     atlasc__free(atlas, g_alloc_ctx);
 }
 
+// prints the mesh coverage of sprites, fails if any opaque pixel is left out of the meshes
+static bool atlasc__report_mesh_coverage(const atlasc_args_files* args,
+                                         const atlasc_atlas_data* atlas)
+{
+    int num_uncovered = 0;
+    int num_failed = 0;
+    float overdraw = 0;
+    for (int i = 0; i < atlas->num_sprites; i++) {
+        const atlasc_sprite* spr = &atlas->sprites[i];
+        printf("%s: %d uncovered pixels, %.2fx overdraw\n", args->in_filepaths[i],
+               spr->mesh_uncovered, spr->mesh_overdraw);
+        num_uncovered += spr->mesh_uncovered;
+        num_failed += spr->mesh_uncovered ? 1 : 0;
+        overdraw += spr->mesh_overdraw;
+    }
+    printf("mesh coverage: %d/%d sprites covered, %.2fx overdraw (average)\n",
+           atlas->num_sprites - num_failed, atlas->num_sprites,
+           atlas->num_sprites ? overdraw / (float)atlas->num_sprites : 0);
+
+    if (num_failed) {
+        sx_snprintf(g_error_str, sizeof(g_error_str),
+                    "meshes of %d sprites leave out %d opaque pixels", num_failed, num_uncovered);
+        return false;
+    }
+    return true;
+}
+
 PUBLIC_DECL bool atlasc_make(const atlasc_args_files* args)
 {
     sx_assert(args);
     sx_assert(args->out_filepath);
 
+    if (args->patch_from && args->common.format != ATLASC_FORMAT_RGBA8) {
+        sx_snprintf(g_error_str, sizeof(g_error_str),
+                    "patches are only supported with rgba8 format");
+        return false;
+    }
+
     if (!g_alloc)
         g_alloc = sx_alloc_malloc();
 
@@ -685,31 +5104,26 @@ PUBLIC_DECL bool atlasc_make(const atlasc_args_files* args)
     }
     sx_memset(images, 0x0, sizeof(atlasc_image_data) * num_images);
 
-    for (int i = 0; i < num_images; i++) {
-        int comp;
-        if (!sx_os_path_isfile(args->in_filepaths[i])) {
-            sx_snprintf(g_error_str, sizeof(g_error_str), "input image not found: %s",
-                        args->in_filepaths[i]);
-            goto err_cleanup;
-        }
-        images[i].pixels =
-            stbi_load(args->in_filepaths[i], &images[i].width, &images[i].height, &comp, 4);
-        if (!images[i].pixels) {
-            sx_snprintf(g_error_str, sizeof(g_error_str), "invalid image format: %s",
-                        args->in_filepaths[i]);
-            goto err_cleanup;
-        }
-    }
+    ATLASC__ZONE_BEGIN("decode");
+    bool loaded = atlasc__load_images(args, images);
+    ATLASC__ZONE_END("decode", loaded ? num_images : 0, 0);
+    if (!loaded)
+        goto err_cleanup;
 
+    // we only serialize the result, so keep the meshes in the compact format
     atlasc_args_frommem args2 = { .common = args->common,
                                   .images = images,
                                   .num_images = num_images };
+    args2.common.quantize_mesh = 1;
     atlasc_atlas_data* atlas = atlasc_make_inmem_frommem(&args2);
-    if (!atlas)
+    if (!atlas) {
+        atlasc__free(images, g_alloc_ctx);
         return false;
+    }
 
-    bool r = atlasc__save(args, atlas->sprites, atlas->num_sprites, atlas->atlas_image.pixels,
-                          atlas->atlas_image.width, atlas->atlas_image.height);
+    bool r = atlasc__save(args, atlas);
+    if (r && args->common.check_mesh)
+        r = atlasc__report_mesh_coverage(args, atlas);
 
     atlasc_free(atlas);
     atlasc__free(images, g_alloc_ctx);
@@ -743,7 +5157,63 @@ PUBLIC_DECL void atlasc_set_alloc_callbacks(atlasc__malloc_cb malloc_fn, atlasc_
     g_alloc_ctx = ctx;
 }
 
+PUBLIC_DECL void atlasc_set_profile_callbacks(atlasc_zone_begin_cb* begin_fn,
+                                             atlasc_zone_end_cb* end_fn, void* ctx)
+{
+    sx_assert(!begin_fn == !end_fn);
+
+    g_zone_begin_fn = begin_fn;
+    g_zone_end_fn = end_fn;
+    g_profile_ctx = ctx;
+}
+
+PUBLIC_DECL void atlasc_set_job_callbacks(atlasc_dispatch_cb* dispatch_fn, atlasc_wait_cb* wait_fn,
+                                          int num_workers, void* ctx)
+{
+    sx_assert(!dispatch_fn || (wait_fn && num_workers > 0));
+
+    g_dispatch_fn = dispatch_fn;
+    g_wait_fn = wait_fn;
+    g_num_host_workers = num_workers;
+    g_job_ctx = ctx;
+}
+
 #ifndef ATLASC_STATIC_LIB
+// "64M", "512k", "1048576". returns -1 if invalid
+static int64_t atlasc__parse_bytes(const char* str)
+{
+    char* end;
+    double n = strtod(str, &end);
+    switch (sx_tolowerchar(*end)) {
+    case 'g': n *= 1024.0; // fallthrough
+    case 'm': n *= 1024.0; // fallthrough
+    case 'k': n *= 1024.0; end++; break;
+    default: break;
+    }
+    return (end == str || *end != '\0' || n <= 0) ? -1 : (int64_t)n;
+}
+
+// returns -1 if invalid
+static int atlasc__parse_format(const char* str)
+{
+    for (int i = 0; i < ATLASC_FORMAT_COUNT; i++) {
+        if (sx_strequalnocase(str, g_formats[i].name))
+            return i;
+    }
+    return -1;
+}
+
+static const char* const g_dither_names[ATLASC_DITHER_COUNT] = { "none", "ordered", "diffuse" };
+
+static int atlasc__parse_dither(const char* str)
+{
+    for (int i = 0; i < ATLASC_DITHER_COUNT; i++) {
+        if (sx_strequalnocase(str, g_dither_names[i]))
+            return i;
+    }
+    return -1;
+}
+
 int main(int argc, char* argv[])
 {
 #    ifdef _DEBUG
@@ -785,6 +5255,49 @@ int main(int argc, char* argv[])
           "Alpha threshold for cropping (0..255)", "Number" },
         { "scale", 's', SX_CMDLINE_OPTYPE_OPTIONAL, 0x0, 's',
           "Set scale for individual images (default:1.0)", "Number" },
+        { "compact", 'c', SX_CMDLINE_OPTYPE_FLAG_SET, &args.common.compact, 1,
+          "Write compact json (schema v2) with flat arrays", NULL },
+        { "binary", 'b', SX_CMDLINE_OPTYPE_FLAG_SET, &args.common.binary, 1,
+          "Write binary descriptor with quantized meshes instead of json", NULL },
+        { "compress", 'z', SX_CMDLINE_OPTYPE_FLAG_SET, &args.common.compress, 1,
+          "Compress the descriptor file (LZ4, see atlasc-reader.h)", NULL },
+        { "optimize", 'O', SX_CMDLINE_OPTYPE_FLAG_SET, &args.common.optimize, 1,
+          "Spend all cores on a smaller output image (slow)", NULL },
+        { "array", 'a', SX_CMDLINE_OPTYPE_FLAG_SET, &args.common.array, 1,
+          "Pack into same-sized pages, written as a DDS texture array", NULL },
+        { "nine-slice", '9', SX_CMDLINE_OPTYPE_FLAG_SET, &args.common.nine_slice, 1,
+          "Collapse uniform stretch regions of nine-slice sprites (.9.png)", NULL },
+        { "dedupe", 'd', SX_CMDLINE_OPTYPE_FLAG_SET, &args.common.dedupe, 1,
+          "Pack identical, mirrored and rotated sprites only once", NULL },
+        { "palettes", 'r', SX_CMDLINE_OPTYPE_FLAG_SET, &args.common.palettes, 1,
+          "Store recolored sprites once, as palette indices with a palette per sprite", NULL },
+        { "cache", 'C', SX_CMDLINE_OPTYPE_REQUIRED, 0x0, 'C',
+          "Keep sprite analysis results in a directory to speed up next builds", "Directory" },
+        { "nearest", 'n', SX_CMDLINE_OPTYPE_FLAG_SET, &args.common.nearest, 1,
+          "Resize with nearest filter (pixel art)", NULL },
+        { "format", 'f', SX_CMDLINE_OPTYPE_REQUIRED, 0x0, 'f',
+          "Output pixel format: rgba8 (default), rgb565, rgba4444, rgba5551", "Format" },
+        { "dither", 'D', SX_CMDLINE_OPTYPE_REQUIRED, 0x0, 'D',
+          "Dithering of 16bit formats: none (default), ordered, diffuse", "Mode" },
+        { "max-memory", 'x', SX_CMDLINE_OPTYPE_REQUIRED, 0x0, 'x',
+          "Memory for decoding input images in parallel, K/M/G suffixes (default: cgroup limit)",
+          "Bytes" },
+        { "cache-limit", 'L', SX_CMDLINE_OPTYPE_REQUIRED, 0x0, 'L',
+          "Remove the least used cache files above this size, K/M/G suffixes", "Bytes" },
+        { "budget", 'g', SX_CMDLINE_OPTYPE_REQUIRED, 0x0, 'g',
+          "Downscale until the atlas fits into memory budget, K/M/G suffixes", "Bytes" },
+        { "hit-mask", 'k', SX_CMDLINE_OPTYPE_REQUIRED, 0x0, 'k',
+          "Write 1bit hit-test masks of sprites in cells of Pixels (1 = exact), needs --binary",
+          "Pixels" },
+        { "colliders", 'e', SX_CMDLINE_OPTYPE_REQUIRED, 0x0, 'e',
+          "Write convex pieces of sprite outlines for physics, at most Number vertices each",
+          "Number" },
+        { "check-mesh", 't', SX_CMDLINE_OPTYPE_FLAG_SET, &args.common.check_mesh, 1,
+          "Report mesh coverage of opaque pixels per sprite, fail if any is left out", NULL },
+        { "patch-from", 'p', SX_CMDLINE_OPTYPE_REQUIRED, 0x0, 'p',
+          "Write patch from the previous build's outputs to the current one", "Filepath" },
+        { "clear-transparent", 'T', SX_CMDLINE_OPTYPE_FLAG_SET, &args.common.clear_transparent, 1,
+          "Zero the color of fully transparent pixels (smaller image, no color bleed)", NULL },
         SX_CMDLINE_OPT_END
     };
 
@@ -803,6 +5316,8 @@ int main(int argc, char* argv[])
         case '!': printf("Invalid use of argument: %s\n", arg); exit(-1); break;
         case 'i': sx_array_push(alloc, args.in_filepaths, (char*)arg); break;
         case 'o': args.out_filepath = arg; break;
+        case 'p': args.patch_from = arg; break;
+        case 'C': args.common.cache_dir = arg; break;
         case 'A': args.common.alpha_threshold = sx_toint(arg); break;
         case 'W': args.common.max_width = sx_toint(arg); break;
         case 'H': args.common.max_height = sx_toint(arg); break;
@@ -810,6 +5325,13 @@ int main(int argc, char* argv[])
         case 'P': args.common.padding = sx_toint(arg); break;
         case 'M': args.common.max_verts_per_mesh = sx_toint(arg); break;
         case 's': args.common.scale = sx_tofloat(arg); break;
+        case 'g': args.common.budget = atlasc__parse_bytes(arg); break;
+        case 'x': args.max_memory = atlasc__parse_bytes(arg); break;
+        case 'L': args.common.cache_limit = atlasc__parse_bytes(arg); break;
+        case 'f': args.common.format = atlasc__parse_format(arg); break;
+        case 'D': args.common.dither = atlasc__parse_dither(arg); break;
+        case 'k': args.common.hit_mask = sx_toint(arg); break;
+        case 'e': args.common.colliders = sx_toint(arg); break;
         default:  break;
         }
     }
@@ -825,6 +5347,52 @@ int main(int argc, char* argv[])
         return -1;
     }
 
+    if (args.common.budget < 0) {
+        puts("'budget' parameter is invalid");
+        return -1;
+    }
+
+    if (args.max_memory < 0) {
+        puts("'max-memory' parameter is invalid");
+        return -1;
+    }
+
+    if (args.common.cache_limit < 0) {
+        puts("'cache-limit' parameter is invalid");
+        return -1;
+    }
+
+    if (args.common.format < 0) {
+        puts("'format' parameter is invalid");
+        return -1;
+    }
+
+    if (args.common.dither < 0) {
+        puts("'dither' parameter is invalid");
+        return -1;
+    }
+
+    if (args.common.hit_mask < 0 || args.common.hit_mask > UINT16_MAX) {
+        puts("'hit-mask' parameter is invalid");
+        return -1;
+    }
+
+    if (args.common.colliders &&
+        (args.common.colliders < 3 || args.common.colliders > UINT8_MAX)) {
+        puts("'colliders' parameter is invalid, pieces need 3 to 255 vertices");
+        return -1;
+    }
+
+    if (args.common.check_mesh && !args.common.mesh) {
+        puts("mesh coverage can only be checked with --mesh");
+        return -1;
+    }
+
+    if (args.common.hit_mask && !args.common.binary) {
+        puts("hit masks are only written to binary descriptors (--binary)");
+        return -1;
+    }
+
     if (!args.in_filepaths) {
         puts("must set at least one input file (-i)");
         return -1;
@@ -844,6 +5412,9 @@ int main(int argc, char* argv[])
 
     args.num_files = sx_array_count(args.in_filepaths);
     bool r = atlasc_make(&args);
+    if (!r && g_error_str[0]) {
+        puts(g_error_str);
+    }
 
     sx_cmdline_destroy_context(cmd, alloc);
     sx_array_free(alloc, args.in_filepaths);